@@ -4,7 +4,6 @@
 
 #include <assert.h>
 #include <charon/element.h>
-#include <charon/lexer.h>
 #include <charon/memory.h>
 #include <charon/parser.h>
 #include <charon/util.h>
@@ -15,6 +14,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 bool supports_ansi = true;
 
@@ -24,26 +24,28 @@ char* ansi_color(const char* text) {
     return strdup(text);
 }
 
-static void print_tree(charon_memory_allocator_t *allocator, charon_element_t *element, int depth) {
+static void print_tree(charon_cursor_t *cursor, int depth) {
     for(size_t i = 0; i < depth * 4; i++) printf(" ");
 
-    switch(charon_element_type(element->inner)) {
+    const charon_element_inner_t *element = charon_cursor_element(cursor);
+    switch(charon_element_type(element)) {
         case CHARON_ELEMENT_TYPE_TRIVIA: assert(false);
         case CHARON_ELEMENT_TYPE_NODE:   {
-            charon_node_kind_t node_kind = charon_element_node_kind(element->inner);
+            charon_node_kind_t node_kind = charon_element_node_kind(element);
 
             printf("%s%s%s\n", node_kind == CHARON_NODE_KIND_ERROR ? ansi_color("\e[41m") : "", charon_node_kind_tostring(node_kind), ansi_color("\e[0m"));
 
-            size_t child_count = charon_element_node_child_count(element->inner);
-            for(size_t i = 0; i < child_count; i++) {
-                print_tree(allocator, charon_element_wrap_node_child(allocator, element, i), depth + 1);
-            }
+            if(!charon_cursor_goto_first_child(cursor)) break;
+            do {
+                print_tree(cursor, depth + 1);
+            } while(charon_cursor_goto_next_sibling(cursor));
+            charon_cursor_goto_parent(cursor);
             break;
         }
         case CHARON_ELEMENT_TYPE_TOKEN:
-            charon_token_kind_t token_kind = charon_element_token_kind(element->inner);
+            charon_token_kind_t token_kind = charon_element_token_kind(element);
             const char *kind_text = charon_token_kind_tostring(token_kind);
-            const charon_utf8_text_t *token_text = charon_element_token_text(element->inner);
+            const charon_utf8_text_t *token_text = charon_element_token_text(element);
             const char *str = token_text == nullptr ? nullptr : charon_utf8_as_string(token_text);
             printf("Token(");
             if(str == nullptr || strcmp(kind_text, str) != 0) {
@@ -56,16 +58,37 @@ static void print_tree(charon_memory_allocator_t *allocator, charon_element_t *e
     }
 }
 
+static void print_footprint(charon_element_footprint_t footprint) {
+    charon_element_footprint_entry_t total = {};
+    printf("FOOTPRINT\n");
+    for(size_t kind = 0; kind < CHARON_NODE_KIND_COUNT; kind++) {
+        charon_element_footprint_entry_t entry = footprint.nodes[kind];
+        if(entry.count == 0) continue;
+        printf("    %-32s %8zu elements %10zu bytes\n", charon_node_kind_tostring(kind), entry.count, entry.bytes);
+        total.count += entry.count;
+        total.bytes += entry.bytes;
+    }
+
+    charon_element_footprint_entry_t others[] = { footprint.tokens, footprint.trivia, footprint.texts };
+    const char *other_names[] = { "Tokens", "Trivia", "Texts" };
+    for(size_t i = 0; i < sizeof(others) / sizeof(others[0]); i++) {
+        printf("    %-32s %8zu elements %10zu bytes\n", other_names[i], others[i].count, others[i].bytes);
+        total.count += others[i].count;
+        total.bytes += others[i].bytes;
+    }
+    printf("    %-32s %8zu elements %10zu bytes\n", "Total", total.count, total.bytes);
+}
+
 int main(int argc, char **argv) {
     if(argc < 2) {
         printf("no path provided\n");
         exit(EXIT_FAILURE);
     }
 
-    if(argc == 3) {
-        if(strcmp(argv[2], "--shut-the-fuck-up") == 0) {
-            supports_ansi = false;
-        }
+    bool show_footprint = false;
+    for(int i = 2; i < argc; i++) {
+        if(strcmp(argv[i], "--shut-the-fuck-up") == 0) supports_ansi = false;
+        if(strcmp(argv[i], "--footprint") == 0) show_footprint = true;
     }
 
     char *name = basename(strdup(argv[1]));
@@ -96,37 +119,36 @@ int main(int argc, char **argv) {
 
     // Parse
     charon_utf8_text_t *text = charon_utf8_from(data, data_size);
-    charon_lexer_t *lexer = charon_lexer_make(cache, text);
-    charon_parser_t *parser = charon_parser_make(cache, lexer);
 
-    charon_parser_output_t parser_output = charon_parser_parse_root(parser);
+    long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    charon_parser_output_t parser_output = charon_parser_parse_root_parallel(cache, text, thread_count > 0 ? thread_count : 1);
 
-    charon_element_t *root_element = charon_element_wrap_root(allocator, parser_output.root);
-    print_tree(allocator, root_element, 0);
+    charon_cursor_t cursor;
+    charon_cursor_init(&cursor, parser_output.root, 0);
+    print_tree(&cursor, 0);
+    charon_cursor_free(&cursor);
 
     charon_diag_item_t *next_diag = parser_output.diagnostics;
     while(next_diag != nullptr) {
         charon_diag_item_t *diag = next_diag;
         next_diag = diag->next;
 
-        charon_element_t *current_element = root_element;
+        charon_cursor_init(&cursor, parser_output.root, 0);
         for(size_t i = 0; i < diag->path->length; i++) {
-            size_t child_index = diag->path->steps[i];
-            assert(charon_element_type(current_element->inner) == CHARON_ELEMENT_TYPE_NODE);
-            assert(charon_element_node_child_count(current_element->inner) > child_index);
-
-            current_element = charon_element_wrap_node_child(allocator, current_element, child_index);
+            if(charon_cursor_goto_child(&cursor, diag->path->steps[i])) continue;
+            printf("diagnostic path leads outside the tree\n");
+            exit(EXIT_FAILURE);
         }
 
         printf("DIAGNOSTIC %s %s\n", charon_diag_tostring(diag->kind), charon_diag_fmt(diag->kind, diag->data));
-        print_tree(allocator, current_element, 0);
+        print_tree(&cursor, 0);
+        charon_cursor_free(&cursor);
 
         charon_path_destroy(diag->path);
         free(diag);
     }
 
-    charon_lexer_destroy(lexer);
-    charon_parser_destroy(parser);
+    if(show_footprint) print_footprint(charon_element_footprint(parser_output.root));
 
     free(text);
     free(data);
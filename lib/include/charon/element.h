@@ -17,6 +17,18 @@ typedef enum {
 typedef struct charon_element_cache charon_element_cache_t;
 typedef struct charon_element_inner charon_element_inner_t;
 
+typedef struct {
+    size_t count, bytes;
+} charon_element_footprint_entry_t;
+
+/**
+ * Memory taken by the distinct elements of a tree, shared elements and texts are counted once.
+ */
+typedef struct {
+    charon_element_footprint_entry_t trivia, tokens, texts;
+    charon_element_footprint_entry_t nodes[CHARON_NODE_KIND_COUNT];
+} charon_element_footprint_t;
+
 typedef struct charon_element {
     const charon_element_inner_t *inner;
     struct charon_element *parent;
@@ -24,12 +36,48 @@ typedef struct charon_element {
     size_t self_index;
 } charon_element_t;
 
+#define CHARON_CURSOR_INLINE_DEPTH 64
+
+typedef struct {
+    const charon_element_inner_t *inner;
+    size_t offset;
+    size_t index;
+} charon_cursor_frame_t;
+
+/**
+ * Walks a tree without wrapping elements, keeping the offset of the current element as it moves.
+ * The path from the start element is kept in the cursor itself, only paths deeper than `CHARON_CURSOR_INLINE_DEPTH` spill to the heap.
+ * The trivia of a token are walked as its children, leading then trailing.
+ */
+typedef struct {
+    size_t depth;
+    charon_cursor_frame_t *spill_frames;
+    size_t spill_capacity;
+    charon_cursor_frame_t frames[CHARON_CURSOR_INLINE_DEPTH];
+} charon_cursor_t;
+
 charon_element_cache_t *charon_element_cache_make(charon_memory_allocator_t *allocator);
 void charon_element_cache_destroy(charon_element_cache_t *cache);
 
-/* Element makers */
-const charon_element_inner_t *charon_element_inner_make_trivia(charon_element_cache_t *cache, charon_trivia_kind_t kind, charon_utf8_text_t *text);
-const charon_element_inner_t *charon_element_inner_make_token(charon_element_cache_t *cache, charon_token_kind_t kind, charon_utf8_text_t *text, size_t leading_trivia_count, size_t trailing_trivia_count, const charon_element_inner_t *trivia[]);
+/**
+ * Number of elements and texts interned in the cache.
+ */
+size_t charon_element_cache_size(charon_element_cache_t *cache);
+
+/**
+ * Free every element that is not part of one of the trees in `roots`, each root is replaced by its equal in the collected cache.
+ * Every other element and wrapper taken from the cache is invalid afterwards, the cache must not be used by other threads during the collection.
+ */
+void charon_element_cache_collect(charon_element_cache_t *cache, const charon_element_inner_t *roots[], size_t root_count);
+
+/**
+ * Measure the bytes used by the elements and interned texts of the tree under `inner_root`, per node kind.
+ */
+charon_element_footprint_t charon_element_footprint(const charon_element_inner_t *inner_root);
+
+/* Element makers, safe to call from several threads sharing the cache */
+const charon_element_inner_t *charon_element_inner_make_trivia(charon_element_cache_t *cache, charon_trivia_kind_t kind, const char *text, size_t text_length);
+const charon_element_inner_t *charon_element_inner_make_token(charon_element_cache_t *cache, charon_token_kind_t kind, const char *text, size_t text_length, bool lookahead_past_line, size_t leading_trivia_count, size_t trailing_trivia_count, const charon_element_inner_t *trivia[]);
 const charon_element_inner_t *charon_element_inner_make_node(charon_element_cache_t *cache, charon_node_kind_t kind, const charon_element_inner_t *children[], size_t child_count);
 
 /* Wrapper */
@@ -38,10 +86,76 @@ charon_element_t *charon_element_wrap_node_child(charon_memory_allocator_t *allo
 charon_element_t *charon_element_wrap_token_leading_trivia(charon_memory_allocator_t *allocator, charon_element_t *element, size_t index);
 charon_element_t *charon_element_wrap_token_trailing_trivia(charon_memory_allocator_t *allocator, charon_element_t *element, size_t index);
 
+/* Cursor */
+void charon_cursor_init(charon_cursor_t *cursor, const charon_element_inner_t *inner_element, size_t offset);
+void charon_cursor_free(charon_cursor_t *cursor);
+
+/**
+ * Depth of the current element below the element the cursor started at.
+ */
+size_t charon_cursor_depth(const charon_cursor_t *cursor);
+
+/**
+ * The element at `depth` on the path to the current element, with its offset and index within its parent.
+ */
+const charon_cursor_frame_t *charon_cursor_frame(const charon_cursor_t *cursor, size_t depth);
+
+const charon_element_inner_t *charon_cursor_element(const charon_cursor_t *cursor);
+size_t charon_cursor_offset(const charon_cursor_t *cursor);
+size_t charon_cursor_index(const charon_cursor_t *cursor);
+
+/**
+ * Each move returns false and leaves the cursor where it is when there is nowhere to go.
+ */
+bool charon_cursor_goto_parent(charon_cursor_t *cursor);
+bool charon_cursor_goto_first_child(charon_cursor_t *cursor);
+bool charon_cursor_goto_next_sibling(charon_cursor_t *cursor);
+bool charon_cursor_goto_child(charon_cursor_t *cursor, size_t index);
+
+/**
+ * Move to the first child of a node with `offset` in its text, zero length children never contain an offset.
+ */
+bool charon_cursor_goto_child_containing_offset(charon_cursor_t *cursor, size_t offset);
+
+/**
+ * Move to the first trivia of a token, leading trivia come first. Siblings of trivia are the other trivia of the token.
+ */
+bool charon_cursor_goto_first_trivia(charon_cursor_t *cursor);
+
+/**
+ * Wrap the current element with its ancestors up to where the cursor started, the start element is wrapped as a root.
+ */
+charon_element_t *charon_cursor_wrap(charon_memory_allocator_t *allocator, const charon_cursor_t *cursor);
+
 /* Generic Accessors */
 charon_element_type_t charon_element_type(const charon_element_inner_t *inner_element);
 size_t charon_element_length(const charon_element_inner_t *inner_element);
 
+/**
+ * Number of newlines in the element, and the width of the text after the last one in UTF-16 code units.
+ */
+size_t charon_element_newline_count(const charon_element_inner_t *inner_element);
+size_t charon_element_last_line_width(const charon_element_inner_t *inner_element);
+
+/**
+ * Whether lexing the token, or any token of the node, examined text on a line after the one its last piece ends on.
+ * Such tokens can change when text on a later line is edited.
+ */
+bool charon_element_lookahead_past_line(const charon_element_inner_t *inner_element);
+
+/**
+ * Whether the element is or contains an error node.
+ */
+bool charon_element_has_error(const charon_element_inner_t *inner_element);
+
+/* Positions, lines and columns count from zero and columns are in UTF-16 code units like LSP positions */
+void charon_element_offset_to_position(const charon_element_inner_t *inner_root, size_t offset, size_t *line, size_t *column);
+
+/**
+ * Offset of a position in the tree, a column past the end of its line is clamped to the newline and a line past the end to the end of the text.
+ */
+size_t charon_element_position_to_offset(const charon_element_inner_t *inner_root, size_t line, size_t column);
+
 /* Trivia Accessors */
 const charon_utf8_text_t *charon_element_trivia_text(const charon_element_inner_t *inner_element);
 charon_trivia_kind_t charon_element_trivia_kind(const charon_element_inner_t *inner_element);
@@ -60,3 +174,14 @@ const charon_element_inner_t *charon_element_token_trailing_trivia(const charon_
 charon_node_kind_t charon_element_node_kind(const charon_element_inner_t *inner_element);
 size_t charon_element_node_child_count(const charon_element_inner_t *inner_element);
 const charon_element_inner_t *charon_element_node_child(const charon_element_inner_t *inner_element, size_t index);
+
+/**
+ * Offset of a child from the start of the node, in constant time.
+ */
+size_t charon_element_node_child_offset(const charon_element_inner_t *inner_element, size_t index);
+
+/**
+ * Index of the child whose text or trivia holds `offset` from the start of the node, or the child count when no child does.
+ * Zero length children never hold an offset. Takes logarithmic time in the number of children.
+ */
+size_t charon_element_node_child_at_offset(const charon_element_inner_t *inner_element, size_t offset);
@@ -8,8 +8,29 @@
 typedef struct charon_lexer charon_lexer_t;
 
 charon_lexer_t *charon_lexer_make(charon_element_cache_t *element_cache, const charon_utf8_text_t *text);
+
+/**
+ * Create a lexer for `text` after an edit replaced `edit_old_length` bytes at `edit_offset` with `edit_new_length` bytes,
+ * `old_root` being the tree parsed from the text before the edit. Tokens before the edited lines are taken from `old_root`,
+ * lexing restarts at the start of the first edited line and stops as soon as it lines up with an old token after the edit again.
+ * `text` may continue past the edited text of `old_root`, the text following it is lexed from scratch.
+ */
+charon_lexer_t *charon_lexer_make_incremental(charon_element_cache_t *element_cache, const charon_utf8_text_t *text, const charon_element_inner_t *old_root, size_t edit_offset, size_t edit_old_length, size_t edit_new_length);
 void charon_lexer_destroy(charon_lexer_t *lexer);
 
 const charon_element_inner_t *charon_lexer_peek(charon_lexer_t *lexer);
 const charon_element_inner_t *charon_lexer_advance(charon_lexer_t *lexer);
+
+/**
+ * Offer an old node of `kind` for reuse. Only incremental lexers have old nodes, a node is offered when it starts at the
+ * lookahead token, contains no errors and neither its tokens nor the token following it are affected by the edit.
+ * The lexer skips over the tokens of the returned node, the lookahead becomes the token after it.
+ */
+const charon_element_inner_t *charon_lexer_reuse_node(charon_lexer_t *lexer, charon_node_kind_t kind);
 bool charon_lexer_is_eof(charon_lexer_t *lexer);
+
+/**
+ * Whether lexing so far wanted to examine text past the end of the text, other than to find the end of file.
+ * Tokens lexed from a fragment of a larger text can then differ from the same tokens lexed in place.
+ */
+bool charon_lexer_is_end_examined(charon_lexer_t *lexer);
@@ -4,6 +4,14 @@
 
 typedef struct charon_memory_allocator charon_memory_allocator_t;
 
+/**
+ * Position of the allocator's scratch region, treat as opaque.
+ */
+typedef struct {
+    size_t depth;
+    void *slab, *cursor, *end;
+} charon_memory_checkpoint_t;
+
 charon_memory_allocator_t *charon_memory_allocator_make();
 void charon_memory_allocator_free(charon_memory_allocator_t *allocator);
 
@@ -12,3 +20,14 @@ void *charon_memory_allocate(charon_memory_allocator_t *allocator, size_t size);
 void *charon_memory_allocate_resize(charon_memory_allocator_t *allocator, void *ptr, size_t size);
 void *charon_memory_allocate_array(charon_memory_allocator_t *allocator, void *array, size_t element_count, size_t element_size);
 void charon_memory_free(charon_memory_allocator_t *allocator, void *ptr);
+
+/**
+ * Open a checkpoint. Until the matching rollback every `charon_memory_allocate` is bump allocated from the
+ * allocator's scratch region, freeing those allocations is a no-op. Checkpoints nest and must be rolled back in reverse order.
+ */
+charon_memory_checkpoint_t charon_memory_checkpoint(charon_memory_allocator_t *allocator);
+
+/**
+ * Release every allocation made since the checkpoint in O(1). Pointers registered with `charon_memory_register_ptr` are kept.
+ */
+void charon_memory_rollback(charon_memory_allocator_t *allocator, charon_memory_checkpoint_t checkpoint);
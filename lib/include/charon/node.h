@@ -8,4 +8,11 @@ typedef enum charon_node_kind {
 #undef NODE
 } charon_node_kind_t;
 
+enum {
+    CHARON_NODE_KIND_COUNT = 0
+#define NODE(...) +1
+#include "charon/nodes.def"
+#undef NODE
+};
+
 const char *charon_node_kind_tostring(charon_node_kind_t kind);
@@ -3,17 +3,44 @@
 #include "charon/diag.h"
 #include "charon/element.h"
 #include "charon/lexer.h"
+#include "charon/node.h"
 
 typedef struct charon_parser charon_parser_t;
 
 typedef struct {
     const charon_element_inner_t *root;
     charon_diag_item_t *diagnostics;
+
+    /**
+     * Whether the result depends on where the input ends, either the parser looked at the end of file or the lexer examined the end of the text.
+     * Without it a fragment of a larger text parses to the same subtree it has in place.
+     */
+    bool is_end_examined;
 } charon_parser_output_t;
 
 charon_parser_t *charon_parser_make(charon_element_cache_t *element_cache, charon_lexer_t *lexer);
 void charon_parser_destroy(charon_parser_t *parser);
 
+typedef charon_parser_output_t (*charon_parser_reparse_fn_t)(charon_parser_t *parser);
+
+charon_parser_output_t charon_parser_parse_type(charon_parser_t *parser);
+charon_parser_output_t charon_parser_parse_type_function(charon_parser_t *parser);
+charon_parser_output_t charon_parser_parse_expr(charon_parser_t *parser);
 charon_parser_output_t charon_parser_parse_stmt(charon_parser_t *parser);
 charon_parser_output_t charon_parser_parse_stmt_block(charon_parser_t *parser);
+charon_parser_output_t charon_parser_parse_tlc(charon_parser_t *parser);
 charon_parser_output_t charon_parser_parse_root(charon_parser_t *parser);
+
+/**
+ * Parse `text` like `charon_parser_parse_root` on up to `thread_count` threads, each lexing and parsing a run of top level items on its own.
+ * The text is split on lines starting a top level item, a split that turns out to be inside an item is undone by parsing both sides together.
+ * Produces the same root and diagnostics as a single parse.
+ */
+charon_parser_output_t charon_parser_parse_root_parallel(charon_element_cache_t *element_cache, const charon_utf8_text_t *text, size_t thread_count);
+
+/**
+ * The entry point that parses a node of `kind` starting at its first token, nullptr when nodes of `kind` are only parsed as part of their parent.
+ * Expressions map to `charon_parser_parse_expr` which parses a whole expression, an operand of another expression is parsed at a precedence
+ * the entry point does not know and reparses to itself only as part of the expression containing it.
+ */
+charon_parser_reparse_fn_t charon_parser_reparse_fn(charon_node_kind_t kind);
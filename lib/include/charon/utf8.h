@@ -7,6 +7,11 @@ typedef struct charon_utf8_text charon_utf8_text_t;
 
 size_t charon_utf8_lead_width(uint8_t ch);
 
+/**
+ * Allocates a text of `data_length` bytes, for callers that write the data in place through `charon_utf8_data` instead of copying it in.
+ */
+charon_utf8_text_t *charon_utf8_make(size_t data_length);
 charon_utf8_text_t *charon_utf8_from(const char *data, size_t data_length);
+char *charon_utf8_data(charon_utf8_text_t *text);
 
 const char *charon_utf8_as_string(const charon_utf8_text_t *text);
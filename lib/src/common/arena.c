@@ -0,0 +1,64 @@
+#include "arena.h"
+
+#include "charon/memory.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_SLAB_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+struct arena_slab {
+    arena_slab_t *next;
+    alignas(max_align_t) uint8_t data[];
+};
+
+static arena_slab_t *slab_make(arena_t *arena, size_t size) {
+    arena_slab_t *slab = charon_memory_allocate(arena->allocator, sizeof(arena_slab_t) + size);
+    slab->next = arena->slabs;
+    arena->slabs = slab;
+    return slab;
+}
+
+void arena_init(arena_t *arena, charon_memory_allocator_t *allocator) {
+    arena->allocator = allocator;
+    arena->slabs = nullptr;
+    arena->cursor = nullptr;
+    arena->end = nullptr;
+}
+
+void *arena_allocate_aligned(arena_t *arena, size_t size, size_t alignment) {
+    assert(alignment > 0 && alignment <= ARENA_ALIGNMENT && (alignment & (alignment - 1)) == 0);
+
+    size = (size + alignment - 1) & ~(alignment - 1);
+    if(arena->cursor != nullptr) {
+        uint8_t *cursor = (uint8_t *) (((uintptr_t) arena->cursor + alignment - 1) & ~(uintptr_t) (alignment - 1));
+        if(cursor <= arena->end && size <= (size_t) (arena->end - cursor)) {
+            arena->cursor = cursor + size;
+            return cursor;
+        }
+    }
+
+    // large allocations get a slab of their own so the remainder of the current slab stays usable
+    if(size > ARENA_SLAB_SIZE / 4) return slab_make(arena, size)->data;
+
+    arena_slab_t *slab = slab_make(arena, ARENA_SLAB_SIZE);
+    arena->cursor = slab->data + size;
+    arena->end = slab->data + ARENA_SLAB_SIZE;
+    return slab->data;
+}
+
+void *arena_allocate(arena_t *arena, size_t size) {
+    return arena_allocate_aligned(arena, size, ARENA_ALIGNMENT);
+}
+
+void arena_free(arena_t *arena) {
+    arena_slab_t *slab = arena->slabs;
+    while(slab != nullptr) {
+        arena_slab_t *next = slab->next;
+        charon_memory_free(arena->allocator, slab);
+        slab = next;
+    }
+    arena_init(arena, arena->allocator);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "charon/memory.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct arena_slab arena_slab_t;
+
+/**
+ * Bump allocator handing out memory from large slabs.
+ * Allocations cannot be freed individually, all of them are released at once by `arena_free`.
+ */
+typedef struct {
+    charon_memory_allocator_t *allocator;
+    arena_slab_t *slabs;
+    uint8_t *cursor, *end;
+} arena_t;
+
+void arena_init(arena_t *arena, charon_memory_allocator_t *allocator);
+
+/**
+ * Allocate memory aligned for any type from the arena.
+ */
+void *arena_allocate(arena_t *arena, size_t size);
+
+/**
+ * Allocate memory with a smaller alignment than `arena_allocate`, so small records are packed without padding.
+ * The alignment must be a power of two no larger than that of any type.
+ */
+void *arena_allocate_aligned(arena_t *arena, size_t size, size_t alignment);
+
+/**
+ * Release every slab of the arena.
+ */
+void arena_free(arena_t *arena);
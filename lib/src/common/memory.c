@@ -3,49 +3,169 @@
 #include "common/fatal.h"
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define INITIAL_CAPACITY 64
+#define REGION_SLAB_SIZE (64 * 1024)
+
+typedef struct region_slab {
+    struct region_slab *next;
+    size_t size;
+    alignas(max_align_t) uint8_t data[];
+} region_slab_t;
+
+/**
+ * Header in front of every region allocation, needed to copy the allocation on resize.
+ */
+typedef struct {
+    alignas(max_align_t) size_t size;
+} region_header_t;
+
+/**
+ * Managed pointers are kept in an open addressing (linear probing) set.
+ * Removal shifts the following entries of the probe chain back, so the set never holds tombstones.
+ */
 struct charon_memory_allocator {
-    size_t entry_count;
+    size_t entry_count, capacity;
     void **entries;
+
+    size_t checkpoint_depth;
+    region_slab_t *region_slabs, *region_current;
+    uint8_t *region_cursor, *region_end;
 };
 
-static size_t find_index(charon_memory_allocator_t *allocator, void *ptr) {
-    for(size_t i = 0; i < allocator->entry_count; i++) {
+static size_t slot_index(charon_memory_allocator_t *allocator, void *ptr) {
+    return (size_t) (((uintptr_t) ptr >> 4) * 0x9e3779b97f4a7c15ULL) & (allocator->capacity - 1);
+}
+
+static bool find_index(charon_memory_allocator_t *allocator, void *ptr, size_t *index) {
+    for(size_t i = slot_index(allocator, ptr); allocator->entries[i] != NULL; i = (i + 1) & (allocator->capacity - 1)) {
         if(allocator->entries[i] != ptr) continue;
-        return i;
+        *index = i;
+        return true;
+    }
+    return false;
+}
+
+static bool region_contains(charon_memory_allocator_t *allocator, void *ptr) {
+    for(region_slab_t *slab = allocator->region_slabs; slab != NULL; slab = slab->next) {
+        if((uint8_t *) ptr >= slab->data && (uint8_t *) ptr < slab->data + slab->size) return true;
+    }
+    return false;
+}
+
+static region_slab_t *region_slab_make(size_t size) {
+    region_slab_t *slab = malloc(sizeof(region_slab_t) + size);
+    slab->next = NULL;
+    slab->size = size;
+    return slab;
+}
+
+/**
+ * Bump allocate from the region, moving on to the next slab (reused from earlier checkpoints when possible) once the current one is full.
+ */
+static void *region_allocate(charon_memory_allocator_t *allocator, size_t size) {
+    size_t total = sizeof(region_header_t) + ((size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1));
+    if(total > (size_t) (allocator->region_end - allocator->region_cursor)) {
+        region_slab_t *next = allocator->region_current == NULL ? allocator->region_slabs : allocator->region_current->next;
+        if(next == NULL || next->size < total) {
+            region_slab_t *slab = region_slab_make(total > REGION_SLAB_SIZE ? total : REGION_SLAB_SIZE);
+            slab->next = next;
+            if(allocator->region_current == NULL) {
+                allocator->region_slabs = slab;
+            } else {
+                allocator->region_current->next = slab;
+            }
+            next = slab;
+        }
+        allocator->region_current = next;
+        allocator->region_cursor = next->data;
+        allocator->region_end = next->data + next->size;
+    }
+
+    region_header_t *header = (region_header_t *) allocator->region_cursor;
+    header->size = size;
+    allocator->region_cursor += total;
+    return header + 1;
+}
+
+static void insert(charon_memory_allocator_t *allocator, void *ptr) {
+    size_t index = slot_index(allocator, ptr);
+    while(allocator->entries[index] != NULL) index = (index + 1) & (allocator->capacity - 1);
+    allocator->entries[index] = ptr;
+    allocator->entry_count++;
+}
+
+static void remove_index(charon_memory_allocator_t *allocator, size_t index) {
+    size_t mask = allocator->capacity - 1;
+    size_t hole = index;
+    for(size_t i = (index + 1) & mask; allocator->entries[i] != NULL; i = (i + 1) & mask) {
+        // an entry may fill the hole unless its home slot lies cyclically between the hole and itself
+        size_t home = slot_index(allocator, allocator->entries[i]);
+        if(((i - home) & mask) < ((i - hole) & mask)) continue;
+        allocator->entries[hole] = allocator->entries[i];
+        hole = i;
     }
-    fatal("pointer `%p` not managed by allocator", ptr);
+    allocator->entries[hole] = NULL;
+    allocator->entry_count--;
+}
+
+static void grow(charon_memory_allocator_t *allocator) {
+    size_t old_capacity = allocator->capacity;
+    void **old_entries = allocator->entries;
+
+    allocator->capacity = old_capacity * 2;
+    allocator->entry_count = 0;
+    allocator->entries = calloc(allocator->capacity, sizeof(void *));
+    for(size_t i = 0; i < old_capacity; i++) {
+        if(old_entries[i] == NULL) continue;
+        insert(allocator, old_entries[i]);
+    }
+    free(old_entries);
 }
 
 charon_memory_allocator_t *charon_memory_allocator_make() {
     charon_memory_allocator_t *allocator = malloc(sizeof(charon_memory_allocator_t));
     allocator->entry_count = 0;
-    allocator->entries = NULL;
+    allocator->capacity = INITIAL_CAPACITY;
+    allocator->entries = calloc(INITIAL_CAPACITY, sizeof(void *));
+    allocator->checkpoint_depth = 0;
+    allocator->region_slabs = NULL;
+    allocator->region_current = NULL;
+    allocator->region_cursor = NULL;
+    allocator->region_end = NULL;
     return allocator;
 }
 
 void charon_memory_allocator_free(charon_memory_allocator_t *allocator) {
-    for(size_t i = 0; i < allocator->entry_count; i++) free(allocator->entries[i]);
+    for(size_t i = 0; i < allocator->capacity; i++) free(allocator->entries[i]);
     free(allocator->entries);
+    region_slab_t *slab = allocator->region_slabs;
+    while(slab != NULL) {
+        region_slab_t *next = slab->next;
+        free(slab);
+        slab = next;
+    }
     free(allocator);
 }
 
 void *charon_memory_register_ptr(charon_memory_allocator_t *allocator, void *ptr) {
-    for(size_t i = 0; i < allocator->entry_count; i++) {
+    for(size_t i = slot_index(allocator, ptr); allocator->entries[i] != NULL; i = (i + 1) & (allocator->capacity - 1)) {
         if(allocator->entries[i] != ptr) continue;
         fatal("double register of pointer `%p`", ptr);
         assert(false);
     }
 
-    allocator->entries = reallocarray(allocator->entries, ++allocator->entry_count, sizeof(void *));
-    allocator->entries[allocator->entry_count - 1] = ptr;
+    if((allocator->entry_count + 1) * 2 > allocator->capacity) grow(allocator);
+    insert(allocator, ptr);
     return ptr;
 }
 
 void *charon_memory_allocate(charon_memory_allocator_t *allocator, size_t size) {
+    if(allocator->checkpoint_depth > 0) return region_allocate(allocator, size);
     void *ptr = malloc(size);
     charon_memory_register_ptr(allocator, ptr);
     return ptr;
@@ -53,9 +173,23 @@ void *charon_memory_allocate(charon_memory_allocator_t *allocator, size_t size)
 
 void *charon_memory_allocate_resize(charon_memory_allocator_t *allocator, void *ptr, size_t size) {
     if(ptr == NULL) return charon_memory_allocate(allocator, size);
-    size_t index = find_index(allocator, ptr);
-    allocator->entries[index] = realloc(ptr, size);
-    return allocator->entries[index];
+
+    size_t index;
+    if(!find_index(allocator, ptr, &index)) {
+        if(!region_contains(allocator, ptr)) fatal("pointer `%p` not managed by allocator", ptr);
+
+        size_t old_size = ((region_header_t *) ptr - 1)->size;
+        void *new_ptr = charon_memory_allocate(allocator, size);
+        memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+        return new_ptr;
+    }
+
+    void *new_ptr = realloc(ptr, size);
+    if(new_ptr == ptr) return ptr;
+
+    remove_index(allocator, index);
+    insert(allocator, new_ptr);
+    return new_ptr;
 }
 
 void *charon_memory_allocate_array(charon_memory_allocator_t *allocator, void *array, size_t element_count, size_t element_size) {
@@ -64,8 +198,27 @@ void *charon_memory_allocate_array(charon_memory_allocator_t *allocator, void *a
 
 void charon_memory_free(charon_memory_allocator_t *allocator, void *ptr) {
     if(ptr == NULL) return;
-    size_t index = find_index(allocator, ptr);
-    memmove(&allocator->entries[index], &allocator->entries[index + 1], (allocator->entry_count - index - 1) * sizeof(void *));
-    allocator->entries = reallocarray(allocator->entries, --allocator->entry_count, sizeof(void *));
+
+    size_t index;
+    if(!find_index(allocator, ptr, &index)) {
+        // region allocations are released by rollback
+        if(region_contains(allocator, ptr)) return;
+        fatal("pointer `%p` not managed by allocator", ptr);
+    }
+
+    remove_index(allocator, index);
     free(ptr);
 }
+
+charon_memory_checkpoint_t charon_memory_checkpoint(charon_memory_allocator_t *allocator) {
+    return (charon_memory_checkpoint_t) { .depth = allocator->checkpoint_depth++, .slab = allocator->region_current, .cursor = allocator->region_cursor, .end = allocator->region_end };
+}
+
+void charon_memory_rollback(charon_memory_allocator_t *allocator, charon_memory_checkpoint_t checkpoint) {
+    if(checkpoint.depth + 1 != allocator->checkpoint_depth) fatal("rollback to a checkpoint that is not the innermost one");
+
+    allocator->checkpoint_depth = checkpoint.depth;
+    allocator->region_current = checkpoint.slab;
+    allocator->region_cursor = checkpoint.cursor;
+    allocator->region_end = checkpoint.end;
+}
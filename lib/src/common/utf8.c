@@ -24,14 +24,23 @@ static size_t byte_offset(const charon_utf8_text_t *text, size_t char_offset) {
     return index;
 }
 
-charon_utf8_text_t *charon_utf8_from(const char *data, size_t data_length) {
+charon_utf8_text_t *charon_utf8_make(size_t data_length) {
     charon_utf8_text_t *text = malloc(sizeof(charon_utf8_text_t) + data_length + 1);
     text->size = data_length;
     text->data[data_length] = '\0';
+    return text;
+}
+
+charon_utf8_text_t *charon_utf8_from(const char *data, size_t data_length) {
+    charon_utf8_text_t *text = charon_utf8_make(data_length);
     memcpy(text->data, data, data_length);
     return text;
 }
 
+char *charon_utf8_data(charon_utf8_text_t *text) {
+    return (char *) text->data;
+}
+
 const char *charon_utf8_as_string(const charon_utf8_text_t *text) {
     return (const char *) text->data;
 }
@@ -42,14 +51,6 @@ utf8_slice_t utf8_slice(const charon_utf8_text_t *text, size_t start_index, size
     return (utf8_slice_t) { .start_index = start_index, .size = size, .text = text };
 }
 
-charon_utf8_text_t *utf8_slice_copy(utf8_slice_t slice) {
-    charon_utf8_text_t *text = malloc(sizeof(charon_utf8_text_t) + slice.size + 1);
-    text->size = slice.size;
-    text->data[slice.size] = '\0';
-    if(slice.size > 0) memcpy(text->data, &slice.text->data[slice.start_index], slice.size);
-    return text;
-}
-
 size_t charon_utf8_lead_width(uint8_t ch) {
     if(0xF0 == (0xF8 & ch)) return 4;
     if(0xE0 == (0xF0 & ch)) return 3;
@@ -21,11 +21,6 @@ typedef struct {
  */
 utf8_slice_t utf8_slice(const charon_utf8_text_t *text, size_t start_index, size_t size);
 
-/**
- * Creates a malloced copy of a slice.
- */
-charon_utf8_text_t *utf8_slice_copy(utf8_slice_t slice);
-
 /**
  * Create a substring from a utf8 codepoint index to the end of the text.
  */
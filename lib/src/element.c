@@ -4,91 +4,423 @@
 #include "charon/memory.h"
 #include "charon/token.h"
 #include "charon/trivia.h"
+#include "common/arena.h"
 #include "common/utf8.h"
 
 #include <assert.h>
+#include <pthread.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
-#define INTERNED_TRIVIA_BUCKET_COUNT 1024
-#define INTERNED_TOKEN_BUCKET_COUNT 16192
-#define INTERNED_NODE_BUCKET_COUNT 8096
+#define INTERN_TABLE_INITIAL_CAPACITY 16
+#define CACHE_SHARD_BITS 4
+#define CACHE_SHARD_COUNT (1 << CACHE_SHARD_BITS)
 
-typedef struct interned_element {
-    struct interned_element *next;
-    charon_element_inner_t element;
-} interned_element_t;
+#define HASH_SEED 0xa0761d6478bd642fULL
+#define HASH_PRIME_1 0xe7037ed1a0b428dbULL
+#define HASH_PRIME_2 0x8ebc6af09c88c6e3ULL
+
+#define TOKEN_INLINE_TEXT_MAX 15
+#define NODE_OFFSET_INDEX_MIN_CHILDREN 16
+
+typedef struct {
+    uint64_t hash;
+    void *entry;
+} intern_slot_t;
+
+/**
+ * Open addressing (linear probing) table of interned entries keyed by their hash.
+ * The hash is stored inline so probing only touches the slot array until a candidate is found.
+ * Capacity is a power of two and doubles once the table is three quarters full.
+ */
+typedef struct {
+    size_t capacity, count;
+    intern_slot_t *slots;
+} intern_table_t;
+
+typedef struct {
+    uint64_t hash;
+    charon_utf8_text_t text;
+} interned_text_t;
+
+/**
+ * Part of the cache holding the entries whose hash selects it, every shard has its own lock so threads interning into one cache rarely contend.
+ * The arena and tables of a shard live in a private allocator as allocators are not thread safe.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    charon_memory_allocator_t *allocator;
+    arena_t arena;
+    intern_table_t texts;
+    intern_table_t trivia;
+    intern_table_t tokens;
+    intern_table_t nodes;
+} cache_shard_t;
 
 struct charon_element_cache {
     charon_memory_allocator_t *allocator;
-    interned_element_t *trivia_buckets[INTERNED_TRIVIA_BUCKET_COUNT];
-    interned_element_t *token_buckets[INTERNED_TOKEN_BUCKET_COUNT];
-    interned_element_t *node_buckets[INTERNED_NODE_BUCKET_COUNT];
+    cache_shard_t shards[CACHE_SHARD_COUNT];
 };
 
-static void free_buckets(charon_memory_allocator_t *allocator, interned_element_t *buckets[], size_t bucket_count) {
-    for(size_t i = 0; i < bucket_count; i++) {
-        interned_element_t *element = buckets[i];
-        while(element != nullptr) {
-            interned_element_t *tmp = element;
-            element = tmp->next;
-            charon_memory_free(allocator, tmp);
+static pthread_once_t g_fixed_texts_once = PTHREAD_ONCE_INIT;
+static const charon_utf8_text_t *g_fixed_texts[CHARON_TOKEN_KIND_COUNT];
+
+/**
+ * Texts shared by every token whose text is the name of its kind, like keywords and punctuation.
+ */
+static void fixed_texts_build() {
+    for(charon_token_kind_t kind = 0; kind < CHARON_TOKEN_KIND_COUNT; kind++) {
+        const char *name = charon_token_kind_tostring(kind);
+        g_fixed_texts[kind] = charon_utf8_from(name, strlen(name));
+    }
+}
+
+static cache_shard_t *cache_shard(charon_element_cache_t *cache, uint64_t hash) {
+    return &cache->shards[hash >> (64 - CACHE_SHARD_BITS)];
+}
+
+static size_t table_index(const intern_table_t *table, uint64_t hash) {
+    return (size_t) (hash * 0x9e3779b97f4a7c15ULL) & (table->capacity - 1);
+}
+
+static size_t table_next(const intern_table_t *table, size_t index) {
+    return (index + 1) & (table->capacity - 1);
+}
+
+static void table_init(charon_memory_allocator_t *allocator, intern_table_t *table, size_t capacity) {
+    table->capacity = capacity;
+    table->count = 0;
+    table->slots = charon_memory_allocate(allocator, capacity * sizeof(intern_slot_t));
+    for(size_t i = 0; i < capacity; i++) table->slots[i] = (intern_slot_t) { .hash = 0, .entry = nullptr };
+}
+
+static void table_free(charon_memory_allocator_t *allocator, intern_table_t *table) {
+    charon_memory_free(allocator, table->slots);
+}
+
+static void table_place(intern_table_t *table, uint64_t hash, void *entry) {
+    size_t index = table_index(table, hash);
+    while(table->slots[index].entry != nullptr) index = table_next(table, index);
+    table->slots[index] = (intern_slot_t) { .hash = hash, .entry = entry };
+    table->count++;
+}
+
+/**
+ * Inserts an entry the caller has verified is not in the table yet.
+ */
+static void table_insert(charon_memory_allocator_t *allocator, intern_table_t *table, uint64_t hash, void *entry) {
+    if((table->count + 1) * 4 > table->capacity * 3) {
+        intern_table_t old_table = *table;
+        table_init(allocator, table, old_table.capacity * 2);
+        for(size_t i = 0; i < old_table.capacity; i++) {
+            if(old_table.slots[i].entry == nullptr) continue;
+            table_place(table, old_table.slots[i].hash, old_table.slots[i].entry);
         }
+        charon_memory_free(allocator, old_table.slots);
     }
+    table_place(table, hash, entry);
+}
+
+/**
+ * Multiplies two words into 128 bits and folds the halves together, every input bit affects every output bit.
+ */
+static uint64_t hash_fold(uint64_t a, uint64_t b) {
+    unsigned __int128 product = (unsigned __int128) a * b;
+    return (uint64_t) product ^ (uint64_t) (product >> 64);
+}
+
+static uint64_t hash_combine(uint64_t hash, uint64_t value) {
+    return hash_fold(hash ^ HASH_PRIME_1, value ^ HASH_PRIME_2);
+}
+
+static uint64_t read_u64(const uint8_t *data) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static uint64_t read_u32(const uint8_t *data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
 }
 
-static uint64_t hash_trivia(charon_trivia_kind_t kind, const charon_utf8_text_t *text) {
-    const uint64_t p = 0x100000001b3ULL;
+/**
+ * Hashes text a word at a time in the manner of wyhash, 16 bytes per step and overlapping reads for the tail so short texts take no loop.
+ */
+static uint64_t hash_text(const char *text, size_t text_length) {
+    const uint8_t *data = (const uint8_t *) text;
 
-    uint64_t h = 0xcbf29ce484222325ULL;
-    h ^= (uint64_t) kind;
-    h *= p;
+    uint64_t h = HASH_SEED;
+    size_t i = 0;
+    for(; i + 16 <= text_length; i += 16) h = hash_fold(read_u64(&data[i]) ^ HASH_PRIME_1, read_u64(&data[i + 8]) ^ h);
 
-    for(size_t i = 0; i < (text == nullptr ? 0 : text->size); ++i) {
-        h ^= text->data[i];
-        h *= p;
+    uint64_t a = 0, b = 0;
+    size_t rest = text_length - i;
+    if(rest >= 8) {
+        a = read_u64(&data[i]);
+        b = read_u64(&data[text_length - 8]);
+    } else if(rest >= 4) {
+        a = read_u32(&data[i]);
+        b = read_u32(&data[text_length - 4]);
+    } else if(rest > 0) {
+        a = ((uint64_t) data[i] << 16) | ((uint64_t) data[i + rest / 2] << 8) | data[text_length - 1];
     }
 
+    return hash_fold(a ^ HASH_PRIME_1, b ^ h ^ text_length);
+}
+
+static uint64_t hash_trivia(charon_trivia_kind_t kind, uint64_t text_hash) {
+    uint64_t h = HASH_SEED;
+    h = hash_combine(h, (uint64_t) kind);
+    h = hash_combine(h, text_hash);
     return h;
 }
 
-static uint64_t hash_token(charon_token_kind_t kind, const charon_utf8_text_t *text, const charon_element_inner_t *trivia[], size_t trivia_count) {
-    const uint64_t p = 0x100000001b3ULL;
+static uint64_t hash_token(charon_token_kind_t kind, uint64_t text_hash, bool lookahead_past_line, const charon_element_inner_t *trivia[], size_t trivia_count) {
+    uint64_t h = HASH_SEED;
+    h = hash_combine(h, ((uint64_t) kind << 1) | (uint64_t) lookahead_past_line);
+    h = hash_combine(h, text_hash);
+    for(size_t i = 0; i < trivia_count; ++i) h = hash_combine(h, trivia[i]->hash);
+    return h;
+}
+
+static uint64_t hash_node(charon_node_kind_t kind, const charon_element_inner_t *children[], size_t child_count) {
+    uint64_t h = HASH_SEED;
+    h = hash_combine(h, ((uint64_t) kind << 32) | (uint64_t) child_count);
+    for(size_t i = 0; i < child_count; ++i) h = hash_combine(h, children[i]->hash);
+    return h;
+}
 
-    uint64_t h = 0xcbf29ce484222325ULL;
-    h ^= (uint64_t) kind;
-    h *= p;
+static const interned_text_t *make_text(cache_shard_t *shard, uint64_t hash, const char *text, size_t text_length) {
+    intern_table_t *table = &shard->texts;
+    for(size_t i = table_index(table, hash); table->slots[i].entry != nullptr; i = table_next(table, i)) {
+        if(table->slots[i].hash != hash) continue;
 
-    for(size_t i = 0; i < (text == nullptr ? 0 : text->size); ++i) {
-        h ^= text->data[i];
-        h *= p;
+        const interned_text_t *interned_text = table->slots[i].entry;
+        if(interned_text->text.size != text_length || memcmp(interned_text->text.data, text, text_length) != 0) continue;
+        return interned_text;
     }
 
-    for(size_t i = 0; i < trivia_count; ++i) {
-        h ^= trivia[i]->hash;
-        h *= p;
+    interned_text_t *interned_text = arena_allocate_aligned(&shard->arena, sizeof(interned_text_t) + text_length + 1, alignof(interned_text_t));
+    interned_text->hash = hash;
+    interned_text->text.size = text_length;
+    memcpy(interned_text->text.data, text, text_length);
+    interned_text->text.data[text_length] = '\0';
+
+    table_insert(shard->allocator, table, hash, interned_text);
+
+    return interned_text;
+}
+
+/**
+ * Interns a copy of the text in the cache, identical texts share one allocation.
+ * Elements refer to interned texts so they never depend on the lifetime of the source buffer.
+ */
+static const interned_text_t *intern_text(charon_element_cache_t *cache, const char *text, size_t text_length, uint64_t hash) {
+    cache_shard_t *shard = cache_shard(cache, hash);
+
+    pthread_mutex_lock(&shard->lock);
+    const interned_text_t *interned_text = make_text(shard, hash, text, text_length);
+    pthread_mutex_unlock(&shard->lock);
+    return interned_text;
+}
+
+static size_t token_trivia_count(const charon_element_inner_t *inner_element) {
+    return inner_element->token.leading_trivia_count + inner_element->token.trailing_trivia_count;
+}
+
+static const charon_utf8_text_t *token_text(const charon_element_inner_t *inner_element) {
+    const void *storage = &inner_element->token.trivia[token_trivia_count(inner_element)];
+    switch((element_text_storage_t) inner_element->text_storage) {
+        case ELEMENT_TEXT_STORAGE_NONE:     return nullptr;
+        case ELEMENT_TEXT_STORAGE_FIXED:    return g_fixed_texts[inner_element->kind];
+        case ELEMENT_TEXT_STORAGE_INLINE:   return storage;
+        case ELEMENT_TEXT_STORAGE_INTERNED: return *(const charon_utf8_text_t *const *) storage;
     }
+    assert(false);
+}
 
-    return h;
+static size_t token_trailing_trivia_length(const charon_element_inner_t *inner_element) {
+    const charon_utf8_text_t *text = token_text(inner_element);
+    return inner_element->length - inner_element->token.leading_trivia_length - (text == nullptr ? 0 : text->size);
 }
 
-static uint64_t hash_node(charon_node_kind_t kind, const charon_element_inner_t *children[], size_t child_count) {
-    const uint64_t p = 0x100000001b3ULL;
+static size_t text_storage_size(element_text_storage_t text_storage, size_t text_length) {
+    switch(text_storage) {
+        case ELEMENT_TEXT_STORAGE_NONE:
+        case ELEMENT_TEXT_STORAGE_FIXED:    return 0;
+        case ELEMENT_TEXT_STORAGE_INLINE:   return sizeof(charon_utf8_text_t) + text_length + 1;
+        case ELEMENT_TEXT_STORAGE_INTERNED: return sizeof(const charon_utf8_text_t *);
+    }
+    assert(false);
+}
+
+static size_t trivia_size() {
+    return offsetof(charon_element_inner_t, trivia.text) + sizeof(const charon_utf8_text_t *);
+}
+
+static size_t token_size(size_t trivia_count, element_text_storage_t text_storage, size_t text_length) {
+    return offsetof(charon_element_inner_t, token.trivia) + trivia_count * sizeof(charon_element_inner_t *) + text_storage_size(text_storage, text_length);
+}
+
+/**
+ * Nodes with at least `NODE_OFFSET_INDEX_MIN_CHILDREN` children store the offset of every child and the newlines before it after the children,
+ * narrower nodes sum the lengths of a few siblings instead.
+ */
+static bool node_has_offset_index(size_t child_count) {
+    return child_count >= NODE_OFFSET_INDEX_MIN_CHILDREN;
+}
+
+static size_t node_size(size_t child_count) {
+    size_t size = offsetof(charon_element_inner_t, node.children) + child_count * sizeof(charon_element_inner_t *);
+    if(node_has_offset_index(child_count)) size += 2 * child_count * sizeof(uint32_t);
+    return size;
+}
+
+static uint32_t *node_child_offsets(const charon_element_inner_t *inner_element) {
+    return (uint32_t *) &inner_element->node.children[inner_element->node.child_count];
+}
+
+static uint32_t *node_child_newlines(const charon_element_inner_t *inner_element) {
+    return node_child_offsets(inner_element) + inner_element->node.child_count;
+}
+
+static size_t node_child_offset(const charon_element_inner_t *inner_element, size_t index) {
+    if(node_has_offset_index(inner_element->node.child_count)) return node_child_offsets(inner_element)[index];
 
-    uint64_t h = 0xcbf29ce484222325ULL;
-    h ^= (uint64_t) kind;
-    h *= p;
+    size_t offset = 0;
+    for(size_t i = 0; i < index; i++) offset += inner_element->node.children[i]->length;
+    return offset;
+}
 
-    h ^= (uint64_t) child_count;
-    h *= p;
+/**
+ * Index of the child with `offset` in its text, or the child count when there is none. Children that start at the offset only come after
+ * the zero length children starting there, so the last child starting at or before the offset is the one that can contain it.
+ */
+static size_t node_child_at_offset(const charon_element_inner_t *inner_element, size_t offset) {
+    size_t child_count = inner_element->node.child_count;
+    size_t index;
+    if(node_has_offset_index(child_count)) {
+        const uint32_t *offsets = node_child_offsets(inner_element);
+        size_t low = 0, high = child_count;
+        while(low < high) {
+            size_t mid = low + (high - low) / 2;
+            if(offsets[mid] <= offset) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        if(low == 0) return child_count;
+        index = low - 1;
+        if(offset < offsets[index] + inner_element->node.children[index]->length) return index;
+        return child_count;
+    }
 
-    for(size_t i = 0; i < child_count; ++i) {
-        h ^= children[i]->hash;
-        h *= p;
+    size_t child_offset = 0;
+    for(index = 0; index < child_count; index++) {
+        child_offset += inner_element->node.children[index]->length;
+        if(offset < child_offset) return index;
     }
+    return child_count;
+}
 
-    return h;
+typedef struct {
+    size_t line, column;
+} position_t;
+
+static bool position_is_before(position_t position, position_t other) {
+    return position.line < other.line || (position.line == other.line && position.column < other.column);
+}
+
+static void position_advance(position_t *position, const charon_element_inner_t *element) {
+    if(element->newline_count > 0) {
+        position->line += element->newline_count;
+        position->column = element->last_line_width;
+    } else {
+        position->column += element->last_line_width;
+    }
+}
+
+/**
+ * Advances the position over the children in front of `index`. Wide nodes take the newlines from their index and only walk back over the
+ * children on the line the child starts on.
+ */
+static void position_advance_children(position_t *position, const charon_element_inner_t *inner_element, size_t index) {
+    if(!node_has_offset_index(inner_element->node.child_count)) {
+        for(size_t i = 0; i < index; i++) position_advance(position, inner_element->node.children[i]);
+        return;
+    }
+
+    size_t width = 0, i = index;
+    for(; i > 0 && inner_element->node.children[i - 1]->newline_count == 0; i--) width += inner_element->node.children[i - 1]->last_line_width;
+    if(i == 0) {
+        position->column += width;
+        return;
+    }
+    position->line += node_child_newlines(inner_element)[index];
+    position->column = inner_element->node.children[i - 1]->last_line_width + width;
+}
+
+/**
+ * Width of a byte in UTF-16 code units, the unit of LSP columns. Lead bytes of four byte sequences need a surrogate pair, continuation bytes add nothing.
+ */
+static size_t utf16_width(uint8_t byte) {
+    if((byte & 0xC0) == 0x80) return 0;
+    return byte >= 0xF0 ? 2 : 1;
+}
+
+static void position_advance_text(position_t *position, const uint8_t *data, size_t size) {
+    for(size_t i = 0; i < size; i++) {
+        if(data[i] == '\n') {
+            position->line++;
+            position->column = 0;
+            continue;
+        }
+        position->column += utf16_width(data[i]);
+    }
+}
+
+/**
+ * Number of bytes of the text in front of `target`, advancing the position over them. A target past the end of its line is clamped to the newline.
+ */
+static size_t position_seek_text(position_t *position, position_t target, const uint8_t *data, size_t size) {
+    for(size_t i = 0; i < size; i++) {
+        if(utf16_width(data[i]) > 0 && !position_is_before(*position, target)) return i;
+        if(data[i] == '\n') {
+            if(position->line == target.line) return i;
+            position->line++;
+            position->column = 0;
+            continue;
+        }
+        position->column += utf16_width(data[i]);
+    }
+    return size;
+}
+
+static void element_lines_append(charon_element_inner_t *element, size_t newline_count, size_t last_line_width) {
+    if(newline_count > 0) {
+        element->newline_count += newline_count;
+        element->last_line_width = last_line_width;
+    } else {
+        element->last_line_width += last_line_width;
+    }
+}
+
+static void element_lines_append_text(charon_element_inner_t *element, const uint8_t *data, size_t size) {
+    size_t newline_count = 0, last_line_width = 0;
+    for(size_t i = 0; i < size; i++) {
+        if(data[i] == '\n') {
+            newline_count++;
+            last_line_width = 0;
+            continue;
+        }
+        last_line_width += utf16_width(data[i]);
+    }
+    element_lines_append(element, newline_count, last_line_width);
 }
 
 static const charon_element_inner_t *token_trivia(const charon_element_inner_t *inner_element, size_t index) {
@@ -103,134 +435,422 @@ static charon_element_t *token_trivia_wrap(charon_memory_allocator_t *allocator,
     trivia->parent = element;
     trivia->offset = element->offset;
     trivia->self_index = index;
-    if(index >= element->inner->token.leading_trivia_count) trivia->offset += element->inner->length - (element->inner->token.leading_trivia_length + element->inner->token.trailing_trivia_length);
+    if(index >= element->inner->token.leading_trivia_count) trivia->offset += element->inner->length - (element->inner->token.leading_trivia_length + token_trailing_trivia_length(element->inner));
     for(size_t i = 0; i < index; i++) trivia->offset += element->inner->token.trivia[i]->length;
 
     return trivia;
 }
 
+static void shard_init(cache_shard_t *shard) {
+    shard->allocator = charon_memory_allocator_make();
+    arena_init(&shard->arena, shard->allocator);
+    table_init(shard->allocator, &shard->texts, INTERN_TABLE_INITIAL_CAPACITY);
+    table_init(shard->allocator, &shard->trivia, INTERN_TABLE_INITIAL_CAPACITY);
+    table_init(shard->allocator, &shard->tokens, INTERN_TABLE_INITIAL_CAPACITY);
+    table_init(shard->allocator, &shard->nodes, INTERN_TABLE_INITIAL_CAPACITY);
+}
+
+static void shard_free(cache_shard_t *shard) {
+    table_free(shard->allocator, &shard->trivia);
+    table_free(shard->allocator, &shard->tokens);
+    table_free(shard->allocator, &shard->nodes);
+    table_free(shard->allocator, &shard->texts);
+    arena_free(&shard->arena);
+    charon_memory_allocator_free(shard->allocator);
+}
+
 charon_element_cache_t *charon_element_cache_make(charon_memory_allocator_t *allocator) {
+    pthread_once(&g_fixed_texts_once, fixed_texts_build);
+
     charon_element_cache_t *cache = charon_memory_allocate(allocator, sizeof(charon_element_cache_t));
     cache->allocator = allocator;
-    for(size_t i = 0; i < INTERNED_TRIVIA_BUCKET_COUNT; i++) cache->trivia_buckets[i] = nullptr;
-    for(size_t i = 0; i < INTERNED_TOKEN_BUCKET_COUNT; i++) cache->token_buckets[i] = nullptr;
-    for(size_t i = 0; i < INTERNED_NODE_BUCKET_COUNT; i++) cache->node_buckets[i] = nullptr;
+    for(size_t i = 0; i < CACHE_SHARD_COUNT; i++) {
+        pthread_mutex_init(&cache->shards[i].lock, nullptr);
+        shard_init(&cache->shards[i]);
+    }
     return cache;
 }
 
 void charon_element_cache_destroy(charon_element_cache_t *cache) {
-    free_buckets(cache->allocator, cache->trivia_buckets, INTERNED_TRIVIA_BUCKET_COUNT);
-    free_buckets(cache->allocator, cache->token_buckets, INTERNED_TOKEN_BUCKET_COUNT);
-    free_buckets(cache->allocator, cache->node_buckets, INTERNED_NODE_BUCKET_COUNT);
+    for(size_t i = 0; i < CACHE_SHARD_COUNT; i++) {
+        shard_free(&cache->shards[i]);
+        pthread_mutex_destroy(&cache->shards[i].lock);
+    }
     charon_memory_free(cache->allocator, cache);
 }
 
-const charon_element_inner_t *charon_element_inner_make_trivia(charon_element_cache_t *cache, charon_trivia_kind_t kind, charon_utf8_text_t *text) {
-    uint64_t hash = hash_trivia(kind, text);
-    size_t index = hash % INTERNED_TRIVIA_BUCKET_COUNT;
+size_t charon_element_cache_size(charon_element_cache_t *cache) {
+    size_t size = 0;
+    for(size_t i = 0; i < CACHE_SHARD_COUNT; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        size += shard->texts.count + shard->trivia.count + shard->tokens.count + shard->nodes.count;
+        pthread_mutex_unlock(&shard->lock);
+    }
+    return size;
+}
 
-    for(interned_element_t *interned_element = cache->trivia_buckets[index]; interned_element != NULL; interned_element = interned_element->next) {
-        if(interned_element->element.trivia.kind != kind) continue;
-        if(interned_element->element.trivia.text == nullptr || text == nullptr) {
-            if(interned_element->element.trivia.text != text) continue;
-        } else {
-            if(interned_element->element.trivia.text->size != text->size) continue;
-            if(memcmp(interned_element->element.trivia.text->data, text->data, text->size) != 0) continue;
-        }
-        return &interned_element->element;
+static const charon_element_inner_t *make_trivia(cache_shard_t *shard, uint64_t hash, charon_trivia_kind_t kind, const charon_utf8_text_t *element_text, size_t text_length) {
+    intern_table_t *table = &shard->trivia;
+    for(size_t i = table_index(table, hash); table->slots[i].entry != nullptr; i = table_next(table, i)) {
+        if(table->slots[i].hash != hash) continue;
+
+        const charon_element_inner_t *element = table->slots[i].entry;
+        if(element->kind != kind || element->trivia.text != element_text) continue;
+        return element;
     }
 
-    interned_element_t *interned_element = charon_memory_allocate(cache->allocator, sizeof(interned_element_t));
-    interned_element->element.type = CHARON_ELEMENT_TYPE_TRIVIA;
-    interned_element->element.hash = hash;
-    interned_element->element.length = text == nullptr ? 0 : text->size;
-    interned_element->element.trivia.kind = kind;
-    interned_element->element.trivia.text = text;
+    charon_element_inner_t *element = arena_allocate_aligned(&shard->arena, trivia_size(), alignof(charon_element_inner_t));
+    element->type = CHARON_ELEMENT_TYPE_TRIVIA;
+    element->lookahead_past_line = false;
+    element->has_error = false;
+    element->text_storage = ELEMENT_TEXT_STORAGE_INTERNED;
+    element->hash = hash;
+    element->length = text_length;
+    element->kind = kind;
+    element->trivia.text = element_text;
+    element->newline_count = 0;
+    element->last_line_width = 0;
+    element_lines_append_text(element, element_text->data, element_text->size);
 
-    interned_element->next = cache->trivia_buckets[index];
-    cache->trivia_buckets[index] = interned_element;
+    table_insert(shard->allocator, table, hash, element);
 
-    return &interned_element->element;
+    return element;
 }
 
-const charon_element_inner_t *charon_element_inner_make_token(charon_element_cache_t *cache, charon_token_kind_t kind, charon_utf8_text_t *text, size_t leading_trivia_count, size_t trailing_trivia_count, const charon_element_inner_t *trivia[]) {
-    uint64_t hash = hash_token(kind, text, trivia, leading_trivia_count + trailing_trivia_count);
-    size_t index = hash % INTERNED_TOKEN_BUCKET_COUNT;
+static const charon_element_inner_t *make_token(cache_shard_t *shard, uint64_t hash, charon_token_kind_t kind, const char *text, size_t text_length, element_text_storage_t text_storage, const interned_text_t *interned_text, bool lookahead_past_line, size_t leading_trivia_count, size_t trailing_trivia_count, const charon_element_inner_t *trivia[]) {
+    intern_table_t *table = &shard->tokens;
+    for(size_t i = table_index(table, hash); table->slots[i].entry != nullptr; i = table_next(table, i)) {
+        if(table->slots[i].hash != hash) continue;
 
-    for(interned_element_t *interned_element = cache->token_buckets[index]; interned_element != NULL; interned_element = interned_element->next) {
-        if(interned_element->element.token.kind != kind) continue;
-        if(interned_element->element.token.text == nullptr || text == nullptr) {
-            if(interned_element->element.token.text != text) continue;
-        } else {
-            if(interned_element->element.token.text->size != text->size) continue;
-            if(memcmp(interned_element->element.token.text->data, text->data, text->size) != 0) continue;
+        const charon_element_inner_t *element = table->slots[i].entry;
+        if(element->kind != kind || element->text_storage != text_storage || element->lookahead_past_line != lookahead_past_line) continue;
+        if(element->token.leading_trivia_count != leading_trivia_count) continue;
+        if(element->token.trailing_trivia_count != trailing_trivia_count) continue;
+        for(size_t j = 0; j < leading_trivia_count + trailing_trivia_count; j++) {
+            if(element->token.trivia[j] != trivia[j]) goto skip;
         }
 
-        if(interned_element->element.token.leading_trivia_count != leading_trivia_count) continue;
-        if(interned_element->element.token.trailing_trivia_count != trailing_trivia_count) continue;
-        for(size_t i = 0; i < leading_trivia_count + trailing_trivia_count; i++) {
-            if(interned_element->element.token.trivia[i] != trivia[i]) goto skip;
-        }
+        const charon_utf8_text_t *element_text = token_text(element);
+        if(element_text != nullptr && (element_text->size != text_length || memcmp(element_text->data, text, text_length) != 0)) continue;
 
-        return &interned_element->element;
+        return element;
     skip:
     }
 
-    interned_element_t *interned_element = charon_memory_allocate(cache->allocator, sizeof(interned_element_t) + (leading_trivia_count + trailing_trivia_count) * sizeof(charon_element_inner_t *));
-    interned_element->element.type = CHARON_ELEMENT_TYPE_TOKEN;
-    interned_element->element.hash = hash;
-    interned_element->element.length = text == nullptr ? 0 : text->size;
-    interned_element->element.token.kind = kind;
-    interned_element->element.token.text = text;
-    interned_element->element.token.leading_trivia_count = leading_trivia_count;
-    interned_element->element.token.trailing_trivia_count = trailing_trivia_count;
-    interned_element->element.token.leading_trivia_length = 0;
-    interned_element->element.token.trailing_trivia_length = 0;
+    charon_element_inner_t *element = arena_allocate_aligned(&shard->arena, token_size(leading_trivia_count + trailing_trivia_count, text_storage, text_length), alignof(charon_element_inner_t));
+    element->type = CHARON_ELEMENT_TYPE_TOKEN;
+    element->lookahead_past_line = lookahead_past_line;
+    element->has_error = false;
+    element->text_storage = text_storage;
+    element->hash = hash;
+    element->kind = kind;
+    element->token.leading_trivia_count = leading_trivia_count;
+    element->token.trailing_trivia_count = trailing_trivia_count;
+    element->token.leading_trivia_length = 0;
+
+    size_t length = text_length;
     for(size_t i = 0; i < leading_trivia_count + trailing_trivia_count; i++) {
-        interned_element->element.token.trivia[i] = trivia[i];
-        interned_element->element.length += trivia[i]->length;
-        if(i < leading_trivia_count) {
-            interned_element->element.token.leading_trivia_length += trivia[i]->length;
+        element->token.trivia[i] = trivia[i];
+        length += trivia[i]->length;
+        if(i < leading_trivia_count) element->token.leading_trivia_length += trivia[i]->length;
+    }
+    assert(length <= UINT32_MAX);
+    element->length = length;
+
+    void *storage = &element->token.trivia[leading_trivia_count + trailing_trivia_count];
+    if(text_storage == ELEMENT_TEXT_STORAGE_INLINE) {
+        charon_utf8_text_t *inline_text = storage;
+        inline_text->size = text_length;
+        memcpy(inline_text->data, text, text_length);
+        inline_text->data[text_length] = '\0';
+    }
+    if(text_storage == ELEMENT_TEXT_STORAGE_INTERNED) *(const charon_utf8_text_t **) storage = &interned_text->text;
+
+    element->newline_count = 0;
+    element->last_line_width = 0;
+    for(size_t i = 0; i < leading_trivia_count; i++) element_lines_append(element, trivia[i]->newline_count, trivia[i]->last_line_width);
+    element_lines_append_text(element, (const uint8_t *) text, text == nullptr ? 0 : text_length);
+    for(size_t i = leading_trivia_count; i < leading_trivia_count + trailing_trivia_count; i++) element_lines_append(element, trivia[i]->newline_count, trivia[i]->last_line_width);
+
+    table_insert(shard->allocator, table, hash, element);
+
+    return element;
+}
+
+static const charon_element_inner_t *make_node(cache_shard_t *shard, uint64_t hash, charon_node_kind_t kind, const charon_element_inner_t *children[], size_t child_count) {
+    intern_table_t *table = &shard->nodes;
+    for(size_t i = table_index(table, hash); table->slots[i].entry != nullptr; i = table_next(table, i)) {
+        if(table->slots[i].hash != hash) continue;
+
+        const charon_element_inner_t *element = table->slots[i].entry;
+        assert(element->type == CHARON_ELEMENT_TYPE_NODE);
+        if(element->kind != kind || element->node.child_count != child_count) continue;
+        for(size_t j = 0; j < child_count; j++) {
+            if(element->node.children[j] != children[j]) goto skip;
+        }
+        return element;
+    skip:
+    }
+
+    assert(child_count <= UINT32_MAX);
+
+    charon_element_inner_t *element = arena_allocate_aligned(&shard->arena, node_size(child_count), alignof(charon_element_inner_t));
+    element->type = CHARON_ELEMENT_TYPE_NODE;
+    element->lookahead_past_line = false;
+    element->has_error = kind == CHARON_NODE_KIND_ERROR;
+    element->text_storage = ELEMENT_TEXT_STORAGE_NONE;
+    element->hash = hash;
+    element->kind = kind;
+    element->node.child_count = child_count;
+
+    element->newline_count = 0;
+    element->last_line_width = 0;
+
+    size_t length = 0;
+    for(size_t i = 0; i < child_count; i++) {
+        if(node_has_offset_index(child_count)) {
+            node_child_offsets(element)[i] = length;
+            node_child_newlines(element)[i] = element->newline_count;
+        }
+        element_lines_append(element, children[i]->newline_count, children[i]->last_line_width);
+        length += children[i]->length;
+        element->lookahead_past_line |= children[i]->lookahead_past_line;
+        element->has_error |= children[i]->has_error;
+        element->node.children[i] = children[i];
+    }
+    assert(length <= UINT32_MAX);
+    element->length = length;
+
+    table_insert(shard->allocator, table, hash, element);
+
+    return element;
+}
+
+const charon_element_inner_t *charon_element_inner_make_trivia(charon_element_cache_t *cache, charon_trivia_kind_t kind, const char *text, size_t text_length) {
+    assert(text != nullptr && text_length <= UINT32_MAX);
+
+    uint64_t text_hash = hash_text(text, text_length);
+    const interned_text_t *interned_text = intern_text(cache, text, text_length, text_hash);
+
+    uint64_t hash = hash_trivia(kind, text_hash);
+    cache_shard_t *shard = cache_shard(cache, hash);
+
+    pthread_mutex_lock(&shard->lock);
+    const charon_element_inner_t *element = make_trivia(shard, hash, kind, &interned_text->text, text_length);
+    pthread_mutex_unlock(&shard->lock);
+    return element;
+}
+
+const charon_element_inner_t *charon_element_inner_make_token(charon_element_cache_t *cache, charon_token_kind_t kind, const char *text, size_t text_length, bool lookahead_past_line, size_t leading_trivia_count, size_t trailing_trivia_count, const charon_element_inner_t *trivia[]) {
+    assert(leading_trivia_count <= UINT32_MAX && trailing_trivia_count <= UINT32_MAX);
+
+    uint64_t text_hash = 0;
+    const interned_text_t *interned_text = nullptr;
+    element_text_storage_t text_storage = ELEMENT_TEXT_STORAGE_NONE;
+    if(text != nullptr) {
+        text_hash = hash_text(text, text_length);
+
+        const charon_utf8_text_t *fixed_text = g_fixed_texts[kind];
+        if(fixed_text->size == text_length && memcmp(fixed_text->data, text, text_length) == 0) {
+            text_storage = ELEMENT_TEXT_STORAGE_FIXED;
+        } else if(text_length <= TOKEN_INLINE_TEXT_MAX) {
+            text_storage = ELEMENT_TEXT_STORAGE_INLINE;
         } else {
-            interned_element->element.token.trailing_trivia_length += trivia[i]->length;
+            text_storage = ELEMENT_TEXT_STORAGE_INTERNED;
+            interned_text = intern_text(cache, text, text_length, text_hash);
         }
     }
 
-    interned_element->next = cache->token_buckets[index];
-    cache->token_buckets[index] = interned_element;
+    uint64_t hash = hash_token(kind, text_hash, lookahead_past_line, trivia, leading_trivia_count + trailing_trivia_count);
+    cache_shard_t *shard = cache_shard(cache, hash);
 
-    return &interned_element->element;
+    pthread_mutex_lock(&shard->lock);
+    const charon_element_inner_t *element = make_token(shard, hash, kind, text, text_length, text_storage, interned_text, lookahead_past_line, leading_trivia_count, trailing_trivia_count, trivia);
+    pthread_mutex_unlock(&shard->lock);
+    return element;
 }
 
 const charon_element_inner_t *charon_element_inner_make_node(charon_element_cache_t *cache, charon_node_kind_t kind, const charon_element_inner_t *children[], size_t child_count) {
     uint64_t hash = hash_node(kind, children, child_count);
-    size_t index = hash % INTERNED_NODE_BUCKET_COUNT;
+    cache_shard_t *shard = cache_shard(cache, hash);
 
-    for(interned_element_t *interned_element = cache->node_buckets[index]; interned_element != NULL; interned_element = interned_element->next) {
-        assert(interned_element->element.type == CHARON_ELEMENT_TYPE_NODE);
-        if(interned_element->element.node.kind != kind || interned_element->element.node.child_count != child_count) continue;
-        for(size_t i = 0; i < interned_element->element.node.child_count; i++) {
-            if(interned_element->element.node.children[i] != children[i]) goto skip;
+    pthread_mutex_lock(&shard->lock);
+    const charon_element_inner_t *element = make_node(shard, hash, kind, children, child_count);
+    pthread_mutex_unlock(&shard->lock);
+    return element;
+}
+
+/**
+ * Element of the collected cache and its copy in the live cache.
+ */
+typedef struct {
+    const charon_element_inner_t *element;
+    const charon_element_inner_t *copy;
+} element_copy_t;
+
+/**
+ * State of copying the live trees into a fresh cache. Copies are looked up by the address of the element so every distinct element
+ * is interned once however often the trees share it. Child and trivia arrays are taken from one scratch stack, the array of an element
+ * lies above those of its ancestors.
+ */
+typedef struct {
+    charon_element_cache_t *cache;
+    charon_memory_allocator_t *allocator;
+    arena_t arena;
+    intern_table_t copies;
+    const charon_element_inner_t **scratch;
+    size_t scratch_size, scratch_capacity;
+} element_copier_t;
+
+static size_t copier_scratch_push(element_copier_t *copier, size_t count) {
+    if(copier->scratch_size + count > copier->scratch_capacity) {
+        while(copier->scratch_size + count > copier->scratch_capacity) copier->scratch_capacity *= 2;
+        copier->scratch = charon_memory_allocate_resize(copier->allocator, copier->scratch, copier->scratch_capacity * sizeof(charon_element_inner_t *));
+    }
+    size_t base = copier->scratch_size;
+    copier->scratch_size += count;
+    return base;
+}
+
+/**
+ * Interns an element of another cache and everything it refers to into the cache of the copier.
+ */
+static const charon_element_inner_t *element_copy(element_copier_t *copier, const charon_element_inner_t *element) {
+    uint64_t hash = hash_combine(HASH_SEED, (uint64_t) (uintptr_t) element);
+    for(size_t i = table_index(&copier->copies, hash); copier->copies.slots[i].entry != nullptr; i = table_next(&copier->copies, i)) {
+        const element_copy_t *copy = copier->copies.slots[i].entry;
+        if(copy->element == element) return copy->copy;
+    }
+
+    const charon_element_inner_t *copy = nullptr;
+    switch(element->type) {
+        case CHARON_ELEMENT_TYPE_TRIVIA: copy = charon_element_inner_make_trivia(copier->cache, element->kind, (const char *) element->trivia.text->data, element->trivia.text->size); break;
+        case CHARON_ELEMENT_TYPE_TOKEN:  {
+            size_t trivia_count = token_trivia_count(element);
+            size_t base = copier_scratch_push(copier, trivia_count);
+            for(size_t i = 0; i < trivia_count; i++) {
+                // copying can grow the scratch stack, it is indexed only once the copy is made
+                const charon_element_inner_t *trivia = element_copy(copier, element->token.trivia[i]);
+                copier->scratch[base + i] = trivia;
+            }
+
+            const charon_utf8_text_t *element_text = token_text(element);
+            const char *text = element_text == nullptr ? nullptr : (const char *) element_text->data;
+            size_t text_length = element_text == nullptr ? 0 : element_text->size;
+            copy = charon_element_inner_make_token(copier->cache, element->kind, text, text_length, element->lookahead_past_line, element->token.leading_trivia_count, element->token.trailing_trivia_count, &copier->scratch[base]);
+
+            copier->scratch_size = base;
+            break;
+        }
+        case CHARON_ELEMENT_TYPE_NODE: {
+            size_t base = copier_scratch_push(copier, element->node.child_count);
+            for(size_t i = 0; i < element->node.child_count; i++) {
+                const charon_element_inner_t *child = element_copy(copier, element->node.children[i]);
+                copier->scratch[base + i] = child;
+            }
+
+            copy = charon_element_inner_make_node(copier->cache, element->kind, &copier->scratch[base], element->node.child_count);
+
+            copier->scratch_size = base;
+            break;
         }
-        return &interned_element->element;
-    skip:
     }
+    assert(copy != nullptr);
 
-    interned_element_t *interned_element = charon_memory_allocate(cache->allocator, sizeof(interned_element_t) + child_count * sizeof(charon_element_inner_t *));
-    interned_element->element.type = CHARON_ELEMENT_TYPE_NODE;
-    interned_element->element.hash = hash;
-    interned_element->element.length = 0;
-    interned_element->element.node.kind = kind;
-    interned_element->element.node.child_count = child_count;
-    for(size_t i = 0; i < child_count; i++) {
-        interned_element->element.length += children[i]->length;
-        interned_element->element.node.children[i] = children[i];
+    element_copy_t *entry = arena_allocate_aligned(&copier->arena, sizeof(element_copy_t), alignof(element_copy_t));
+    entry->element = element;
+    entry->copy = copy;
+    table_insert(copier->allocator, &copier->copies, hash, entry);
+    return copy;
+}
+
+void charon_element_cache_collect(charon_element_cache_t *cache, const charon_element_inner_t *roots[], size_t root_count) {
+    // the live trees are interned into a fresh cache whose shards then replace the old ones
+    charon_element_cache_t *live = charon_element_cache_make(cache->allocator);
+
+    element_copier_t copier = { .cache = live, .allocator = charon_memory_allocator_make(), .scratch_size = 0, .scratch_capacity = INTERN_TABLE_INITIAL_CAPACITY };
+    arena_init(&copier.arena, copier.allocator);
+    table_init(copier.allocator, &copier.copies, INTERN_TABLE_INITIAL_CAPACITY);
+    copier.scratch = charon_memory_allocate(copier.allocator, copier.scratch_capacity * sizeof(charon_element_inner_t *));
+    for(size_t i = 0; i < root_count; i++) roots[i] = element_copy(&copier, roots[i]);
+    charon_memory_free(copier.allocator, copier.scratch);
+    table_free(copier.allocator, &copier.copies);
+    arena_free(&copier.arena);
+    charon_memory_allocator_free(copier.allocator);
+
+    for(size_t i = 0; i < CACHE_SHARD_COUNT; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        cache_shard_t *live_shard = &live->shards[i];
+
+        shard_free(shard);
+        shard->allocator = live_shard->allocator;
+        shard->arena = live_shard->arena;
+        shard->texts = live_shard->texts;
+        shard->trivia = live_shard->trivia;
+        shard->tokens = live_shard->tokens;
+        shard->nodes = live_shard->nodes;
+
+        pthread_mutex_destroy(&live_shard->lock);
+    }
+    charon_memory_free(cache->allocator, live);
+}
+
+/**
+ * Adds `entry` to the set unless it is there already, the set uses the table of the cache with the address as hash.
+ */
+static bool footprint_visit(charon_memory_allocator_t *allocator, intern_table_t *visited, const void *entry) {
+    uint64_t hash = hash_combine(HASH_SEED, (uint64_t) (uintptr_t) entry);
+    for(size_t i = table_index(visited, hash); visited->slots[i].entry != nullptr; i = table_next(visited, i)) {
+        if(visited->slots[i].entry == entry) return false;
+    }
+    table_insert(allocator, visited, hash, (void *) entry);
+    return true;
+}
+
+static void footprint_add(charon_element_footprint_entry_t *entry, size_t bytes) {
+    entry->count++;
+    entry->bytes += (bytes + alignof(charon_element_inner_t) - 1) & ~(alignof(charon_element_inner_t) - 1);
+}
+
+static void footprint_text(charon_memory_allocator_t *allocator, intern_table_t *visited, charon_element_footprint_t *footprint, const charon_utf8_text_t *text) {
+    if(!footprint_visit(allocator, visited, text)) return;
+    footprint_add(&footprint->texts, sizeof(interned_text_t) + text->size + 1);
+}
+
+static void footprint_element(charon_memory_allocator_t *allocator, intern_table_t *visited, charon_element_footprint_t *footprint, const charon_element_inner_t *element) {
+    if(!footprint_visit(allocator, visited, element)) return;
+
+    switch(element->type) {
+        case CHARON_ELEMENT_TYPE_TRIVIA:
+            footprint_add(&footprint->trivia, trivia_size());
+            footprint_text(allocator, visited, footprint, element->trivia.text);
+            break;
+        case CHARON_ELEMENT_TYPE_TOKEN: {
+            const charon_utf8_text_t *text = token_text(element);
+            footprint_add(&footprint->tokens, token_size(token_trivia_count(element), element->text_storage, text == nullptr ? 0 : text->size));
+            if(element->text_storage == ELEMENT_TEXT_STORAGE_INTERNED) footprint_text(allocator, visited, footprint, text);
+            for(size_t i = 0; i < token_trivia_count(element); i++) footprint_element(allocator, visited, footprint, element->token.trivia[i]);
+            break;
+        }
+        case CHARON_ELEMENT_TYPE_NODE:
+            footprint_add(&footprint->nodes[element->kind], node_size(element->node.child_count));
+            for(size_t i = 0; i < element->node.child_count; i++) footprint_element(allocator, visited, footprint, element->node.children[i]);
+            break;
     }
+}
 
-    interned_element->next = cache->node_buckets[index];
-    cache->node_buckets[index] = interned_element;
+charon_element_footprint_t charon_element_footprint(const charon_element_inner_t *inner_root) {
+    charon_element_footprint_t footprint = {};
 
-    return &interned_element->element;
+    charon_memory_allocator_t *allocator = charon_memory_allocator_make();
+    intern_table_t visited;
+    table_init(allocator, &visited, INTERN_TABLE_INITIAL_CAPACITY);
+    footprint_element(allocator, &visited, &footprint, inner_root);
+    table_free(allocator, &visited);
+    charon_memory_allocator_free(allocator);
+
+    return footprint;
 }
 
 charon_element_t *charon_element_wrap_root(charon_memory_allocator_t *allocator, const charon_element_inner_t *inner_root) {
@@ -246,9 +866,8 @@ charon_element_t *charon_element_wrap_node_child(charon_memory_allocator_t *allo
     charon_element_t *child = charon_memory_allocate(allocator, sizeof(charon_element_t));
     child->inner = charon_element_node_child(element->inner, index);
     child->parent = element;
-    child->offset = element->offset;
+    child->offset = element->offset + node_child_offset(element->inner, index);
     child->self_index = index;
-    for(size_t i = 0; i < index; i++) child->offset += element->inner->node.children[i]->length;
 
     return child;
 }
@@ -263,6 +882,135 @@ charon_element_t *charon_element_wrap_token_trailing_trivia(charon_memory_alloca
     return token_trivia_wrap(allocator, element, element->inner->token.leading_trivia_count + index);
 }
 
+static charon_cursor_frame_t *cursor_frames(charon_cursor_t *cursor) {
+    return cursor->spill_frames != nullptr ? cursor->spill_frames : cursor->frames;
+}
+
+static const charon_cursor_frame_t *cursor_frames_const(const charon_cursor_t *cursor) {
+    return cursor->spill_frames != nullptr ? cursor->spill_frames : cursor->frames;
+}
+
+static void cursor_push(charon_cursor_t *cursor, const charon_element_inner_t *inner_element, size_t offset, size_t index) {
+    size_t capacity = cursor->spill_frames != nullptr ? cursor->spill_capacity : CHARON_CURSOR_INLINE_DEPTH;
+    if(cursor->depth + 1 == capacity) {
+        charon_cursor_frame_t *spill_frames = reallocarray(cursor->spill_frames, capacity * 2, sizeof(charon_cursor_frame_t));
+        if(cursor->spill_frames == nullptr) memcpy(spill_frames, cursor->frames, sizeof(cursor->frames));
+        cursor->spill_frames = spill_frames;
+        cursor->spill_capacity = capacity * 2;
+    }
+    cursor_frames(cursor)[++cursor->depth] = (charon_cursor_frame_t) { .inner = inner_element, .offset = offset, .index = index };
+}
+
+void charon_cursor_init(charon_cursor_t *cursor, const charon_element_inner_t *inner_element, size_t offset) {
+    cursor->depth = 0;
+    cursor->spill_frames = nullptr;
+    cursor->spill_capacity = 0;
+    cursor->frames[0] = (charon_cursor_frame_t) { .inner = inner_element, .offset = offset, .index = 0 };
+}
+
+void charon_cursor_free(charon_cursor_t *cursor) {
+    free(cursor->spill_frames);
+    cursor->spill_frames = nullptr;
+}
+
+size_t charon_cursor_depth(const charon_cursor_t *cursor) {
+    return cursor->depth;
+}
+
+const charon_cursor_frame_t *charon_cursor_frame(const charon_cursor_t *cursor, size_t depth) {
+    assert(depth <= cursor->depth);
+    return &cursor_frames_const(cursor)[depth];
+}
+
+const charon_element_inner_t *charon_cursor_element(const charon_cursor_t *cursor) {
+    return cursor_frames_const(cursor)[cursor->depth].inner;
+}
+
+size_t charon_cursor_offset(const charon_cursor_t *cursor) {
+    return cursor_frames_const(cursor)[cursor->depth].offset;
+}
+
+size_t charon_cursor_index(const charon_cursor_t *cursor) {
+    return cursor_frames_const(cursor)[cursor->depth].index;
+}
+
+bool charon_cursor_goto_parent(charon_cursor_t *cursor) {
+    if(cursor->depth == 0) return false;
+    cursor->depth--;
+    return true;
+}
+
+bool charon_cursor_goto_first_child(charon_cursor_t *cursor) {
+    const charon_cursor_frame_t *frame = &cursor_frames(cursor)[cursor->depth];
+    if(frame->inner->type != CHARON_ELEMENT_TYPE_NODE || frame->inner->node.child_count == 0) return false;
+    cursor_push(cursor, frame->inner->node.children[0], frame->offset, 0);
+    return true;
+}
+
+bool charon_cursor_goto_next_sibling(charon_cursor_t *cursor) {
+    if(cursor->depth == 0) return false;
+
+    charon_cursor_frame_t *parent = &cursor_frames(cursor)[cursor->depth - 1];
+    charon_cursor_frame_t *frame = &cursor_frames(cursor)[cursor->depth];
+    size_t index = frame->index + 1;
+    size_t offset = frame->offset + frame->inner->length;
+    if(parent->inner->type == CHARON_ELEMENT_TYPE_NODE) {
+        if(index >= parent->inner->node.child_count) return false;
+        frame->inner = parent->inner->node.children[index];
+    } else {
+        if(index >= token_trivia_count(parent->inner)) return false;
+        // the text of the token lies between its leading and trailing trivia
+        if(index == parent->inner->token.leading_trivia_count) offset = parent->offset + parent->inner->length - token_trailing_trivia_length(parent->inner);
+        frame->inner = parent->inner->token.trivia[index];
+    }
+    frame->offset = offset;
+    frame->index = index;
+    return true;
+}
+
+bool charon_cursor_goto_child(charon_cursor_t *cursor, size_t index) {
+    const charon_cursor_frame_t *frame = &cursor_frames(cursor)[cursor->depth];
+    if(frame->inner->type != CHARON_ELEMENT_TYPE_NODE || index >= frame->inner->node.child_count) return false;
+
+    cursor_push(cursor, frame->inner->node.children[index], frame->offset + node_child_offset(frame->inner, index), index);
+    return true;
+}
+
+bool charon_cursor_goto_child_containing_offset(charon_cursor_t *cursor, size_t offset) {
+    const charon_cursor_frame_t *frame = &cursor_frames(cursor)[cursor->depth];
+    if(frame->inner->type != CHARON_ELEMENT_TYPE_NODE || offset < frame->offset) return false;
+
+    size_t index = node_child_at_offset(frame->inner, offset - frame->offset);
+    if(index == frame->inner->node.child_count) return false;
+    cursor_push(cursor, frame->inner->node.children[index], frame->offset + node_child_offset(frame->inner, index), index);
+    return true;
+}
+
+bool charon_cursor_goto_first_trivia(charon_cursor_t *cursor) {
+    const charon_cursor_frame_t *frame = &cursor_frames(cursor)[cursor->depth];
+    if(frame->inner->type != CHARON_ELEMENT_TYPE_TOKEN || token_trivia_count(frame->inner) == 0) return false;
+
+    size_t offset = frame->offset;
+    if(frame->inner->token.leading_trivia_count == 0) offset += frame->inner->length - token_trailing_trivia_length(frame->inner);
+    cursor_push(cursor, frame->inner->token.trivia[0], offset, 0);
+    return true;
+}
+
+charon_element_t *charon_cursor_wrap(charon_memory_allocator_t *allocator, const charon_cursor_t *cursor) {
+    const charon_cursor_frame_t *frames = cursor_frames_const(cursor);
+
+    charon_element_t *element = nullptr;
+    for(size_t i = 0; i <= cursor->depth; i++) {
+        charon_element_t *child = charon_memory_allocate(allocator, sizeof(charon_element_t));
+        child->inner = frames[i].inner;
+        child->parent = element;
+        child->offset = frames[i].offset;
+        child->self_index = frames[i].index;
+        element = child;
+    }
+    return element;
+}
+
 charon_element_type_t charon_element_type(const charon_element_inner_t *inner_element) {
     return inner_element->type;
 }
@@ -271,6 +1019,14 @@ size_t charon_element_length(const charon_element_inner_t *inner_element) {
     return inner_element->length;
 }
 
+bool charon_element_lookahead_past_line(const charon_element_inner_t *inner_element) {
+    return inner_element->lookahead_past_line;
+}
+
+bool charon_element_has_error(const charon_element_inner_t *inner_element) {
+    return inner_element->has_error;
+}
+
 const charon_utf8_text_t *charon_element_trivia_text(const charon_element_inner_t *inner_element) {
     assert(inner_element->type == CHARON_ELEMENT_TYPE_TRIVIA);
     return inner_element->trivia.text;
@@ -278,17 +1034,17 @@ const charon_utf8_text_t *charon_element_trivia_text(const charon_element_inner_
 
 charon_trivia_kind_t charon_element_trivia_kind(const charon_element_inner_t *inner_element) {
     assert(inner_element->type == CHARON_ELEMENT_TYPE_TRIVIA);
-    return inner_element->trivia.kind;
+    return inner_element->kind;
 }
 
 const charon_utf8_text_t *charon_element_token_text(const charon_element_inner_t *inner_element) {
     assert(inner_element->type == CHARON_ELEMENT_TYPE_TOKEN);
-    return inner_element->token.text;
+    return token_text(inner_element);
 }
 
 charon_token_kind_t charon_element_token_kind(const charon_element_inner_t *inner_element) {
     assert(inner_element->type == CHARON_ELEMENT_TYPE_TOKEN);
-    return inner_element->token.kind;
+    return inner_element->kind;
 }
 
 size_t charon_element_token_leading_trivia_count(const charon_element_inner_t *inner_element) {
@@ -308,7 +1064,7 @@ size_t charon_element_token_leading_trivia_length(const charon_element_inner_t *
 
 size_t charon_element_token_trailing_trivia_length(const charon_element_inner_t *inner_element) {
     assert(inner_element->type == CHARON_ELEMENT_TYPE_TOKEN);
-    return inner_element->token.trailing_trivia_length;
+    return token_trailing_trivia_length(inner_element);
 }
 
 const charon_element_inner_t *charon_element_token_leading_trivia(const charon_element_inner_t *inner_element, size_t index) {
@@ -323,7 +1079,7 @@ const charon_element_inner_t *charon_element_token_trailing_trivia(const charon_
 
 charon_node_kind_t charon_element_node_kind(const charon_element_inner_t *inner_element) {
     assert(inner_element->type == CHARON_ELEMENT_TYPE_NODE);
-    return inner_element->node.kind;
+    return inner_element->kind;
 }
 
 size_t charon_element_node_child_count(const charon_element_inner_t *inner_element) {
@@ -336,3 +1092,159 @@ const charon_element_inner_t *charon_element_node_child(const charon_element_inn
     assert(index < inner_element->node.child_count);
     return inner_element->node.children[index];
 }
+
+size_t charon_element_node_child_offset(const charon_element_inner_t *inner_element, size_t index) {
+    assert(inner_element->type == CHARON_ELEMENT_TYPE_NODE);
+    assert(index < inner_element->node.child_count);
+    return node_child_offset(inner_element, index);
+}
+
+size_t charon_element_node_child_at_offset(const charon_element_inner_t *inner_element, size_t offset) {
+    assert(inner_element->type == CHARON_ELEMENT_TYPE_NODE);
+    return node_child_at_offset(inner_element, offset);
+}
+
+size_t charon_element_newline_count(const charon_element_inner_t *inner_element) {
+    return inner_element->newline_count;
+}
+
+size_t charon_element_last_line_width(const charon_element_inner_t *inner_element) {
+    return inner_element->last_line_width;
+}
+
+void charon_element_offset_to_position(const charon_element_inner_t *inner_root, size_t offset, size_t *line, size_t *column) {
+    assert(offset <= inner_root->length);
+
+    position_t position = { .line = 0, .column = 0 };
+    const charon_element_inner_t *element = inner_root;
+    while(element != nullptr) {
+        switch(element->type) {
+            case CHARON_ELEMENT_TYPE_TRIVIA:
+                position_advance_text(&position, element->trivia.text->data, offset);
+                element = nullptr;
+                break;
+            case CHARON_ELEMENT_TYPE_TOKEN: {
+                const charon_element_inner_t *token = element;
+                element = nullptr;
+
+                size_t i = 0;
+                for(; i < token->token.leading_trivia_count && element == nullptr; i++) {
+                    if(offset < token->token.trivia[i]->length) {
+                        element = token->token.trivia[i];
+                        break;
+                    }
+                    position_advance(&position, token->token.trivia[i]);
+                    offset -= token->token.trivia[i]->length;
+                }
+                if(element != nullptr) break;
+
+                const charon_utf8_text_t *text = token_text(token);
+                size_t text_length = text == nullptr ? 0 : text->size;
+                if(text != nullptr) position_advance_text(&position, text->data, offset < text_length ? offset : text_length);
+                if(offset <= text_length) break;
+                offset -= text_length;
+
+                for(; i < token_trivia_count(token); i++) {
+                    if(offset <= token->token.trivia[i]->length) {
+                        element = token->token.trivia[i];
+                        break;
+                    }
+                    position_advance(&position, token->token.trivia[i]);
+                    offset -= token->token.trivia[i]->length;
+                }
+                break;
+            }
+            case CHARON_ELEMENT_TYPE_NODE: {
+                size_t index = node_child_at_offset(element, offset);
+                if(index == element->node.child_count) {
+                    // only the end of the node is held by no child
+                    position_advance(&position, element);
+                    element = nullptr;
+                    break;
+                }
+
+                position_advance_children(&position, element, index);
+                offset -= node_child_offset(element, index);
+                element = element->node.children[index];
+                break;
+            }
+        }
+    }
+
+    *line = position.line;
+    *column = position.column;
+}
+
+size_t charon_element_position_to_offset(const charon_element_inner_t *inner_root, size_t line, size_t column) {
+    position_t target = { .line = line, .column = column };
+    position_t position = { .line = 0, .column = 0 };
+    size_t offset = 0;
+
+    // every element descended into ends after the target, so an element is only passed over when the target lies beyond it
+    const charon_element_inner_t *element = inner_root;
+    while(true) {
+        switch(element->type) {
+            case CHARON_ELEMENT_TYPE_TRIVIA: return offset + position_seek_text(&position, target, element->trivia.text->data, element->trivia.text->size);
+            case CHARON_ELEMENT_TYPE_TOKEN:  {
+                const charon_element_inner_t *token = element;
+                const charon_utf8_text_t *text = token_text(token);
+                for(size_t i = 0; i <= token_trivia_count(token); i++) {
+                    if(i == token->token.leading_trivia_count && text != nullptr) {
+                        size_t text_offset = position_seek_text(&position, target, text->data, text->size);
+                        if(text_offset < text->size) return offset + text_offset;
+                        offset += text->size;
+                    }
+                    if(i == token_trivia_count(token)) break;
+
+                    const charon_element_inner_t *trivia = token->token.trivia[i];
+                    position_t end = position;
+                    position_advance(&end, trivia);
+                    if(position_is_before(target, end)) {
+                        element = trivia;
+                        break;
+                    }
+                    position = end;
+                    offset += trivia->length;
+                }
+                if(element == token) return offset;
+                break;
+            }
+            case CHARON_ELEMENT_TYPE_NODE: {
+                const charon_element_inner_t *node = element;
+
+                // wide nodes skip to the child holding the newline in front of the target line, columns do not matter before that line
+                size_t start = 0;
+                if(node_has_offset_index(node->node.child_count) && target.line > position.line) {
+                    const uint32_t *newlines = node_child_newlines(node);
+                    size_t low = 0, high = node->node.child_count;
+                    while(low < high) {
+                        size_t mid = low + (high - low) / 2;
+                        if(newlines[mid] < target.line - position.line) {
+                            low = mid + 1;
+                        } else {
+                            high = mid;
+                        }
+                    }
+                    start = low - 1;
+                    offset += node_child_offsets(node)[start];
+                    position.line += newlines[start];
+                    position.column = 0;
+                }
+
+                for(size_t i = start; i < node->node.child_count; i++) {
+                    const charon_element_inner_t *child = node->node.children[i];
+                    position_t end = position;
+                    position_advance(&end, child);
+                    if(position_is_before(target, end)) {
+                        element = child;
+                        break;
+                    }
+                    position = end;
+                    offset += child->length;
+                }
+                if(element == node) return offset;
+                break;
+            }
+        }
+    }
+}
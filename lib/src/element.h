@@ -2,32 +2,53 @@
 
 #include "charon/element.h"
 
+#include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
 
+/**
+ * Where the text of a token is stored, see `charon_element_token_text`.
+ * Keywords and punctuation whose text is the name of their kind share one text per kind and store nothing,
+ * other short texts are stored inline after the trivia and longer ones are interned and referenced after the trivia.
+ */
+typedef enum {
+    ELEMENT_TEXT_STORAGE_NONE,
+    ELEMENT_TEXT_STORAGE_FIXED,
+    ELEMENT_TEXT_STORAGE_INLINE,
+    ELEMENT_TEXT_STORAGE_INTERNED
+} element_text_storage_t;
+
+/**
+ * Every element starts with a 24 byte header, the kind is that of the trivia, token or node depending on `type`.
+ * The header also holds the number of newlines in the element and the width of its last line in UTF-16 code units,
+ * so positions can be found by descending the tree.
+ * Lengths and counts are 32 bit, an element is allocated with just the space its variant and trailing arrays need.
+ */
 struct charon_element_inner {
     uint64_t hash;
-    size_t length;
-
-    charon_element_type_t type;
+    uint32_t length;
+    uint32_t newline_count;
+    uint32_t last_line_width;
+    uint16_t kind;
+    uint8_t type : 2;
+    uint8_t lookahead_past_line : 1;
+    uint8_t has_error : 1;
+    uint8_t text_storage : 2;
     union {
         struct {
-            charon_trivia_kind_t kind;
-            charon_utf8_text_t *text;
+            const charon_utf8_text_t *text;
         } trivia;
         struct {
-            charon_token_kind_t kind;
-            charon_utf8_text_t *text;
-
-            size_t leading_trivia_count, leading_trivia_length;
-            size_t trailing_trivia_count, trailing_trivia_length;
+            uint32_t leading_trivia_count, trailing_trivia_count;
+            uint32_t leading_trivia_length;
             const struct charon_element_inner *trivia[];
         } token;
         struct {
-            charon_node_kind_t kind;
-
-            size_t child_count;
+            uint32_t child_count;
+            // wide nodes are followed by the uint32_t offset of each child and then the newlines before each child, see `node_has_offset_index`
             const struct charon_element_inner *children[];
         } node;
     };
 };
+
+static_assert(offsetof(struct charon_element_inner, trivia) == 24, "element header must stay 24 bytes");
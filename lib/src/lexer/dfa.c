@@ -0,0 +1,566 @@
+#include "dfa.h"
+
+#include "common/fatal.h"
+#include "common/utf8.h"
+#include "lexer/spec.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NONE SIZE_MAX
+
+#define DFA_STATE_DEAD 0
+#define DFA_STATE_START 1
+#define DFA_STATE_BAIL UINT16_MAX
+#define DFA_STATE_LIMIT (UINT16_MAX - 1)
+
+typedef enum {
+    NFA_STATE_TYPE_EPSILON,
+    NFA_STATE_TYPE_SET,
+    NFA_STATE_TYPE_ACCEPT,
+    NFA_STATE_TYPE_BAIL
+} nfa_state_type_t;
+
+typedef struct {
+    nfa_state_type_t type;
+    size_t pattern;
+    size_t out[2];
+    uint64_t set[4];
+    bool boundary;
+} nfa_state_t;
+
+typedef struct {
+    size_t start, end;
+} nfa_fragment_t;
+
+typedef struct {
+    size_t count;
+    size_t *states;
+} nfa_set_t;
+
+typedef enum {
+    CLASS_NONASCII_NONE,
+    CLASS_NONASCII_ALL,
+    CLASS_NONASCII_UNICODE
+} class_nonascii_t;
+
+typedef struct {
+    uint64_t set[4];
+    bool has_space, has_nonspace, has_unicode;
+} char_class_t;
+
+typedef struct {
+    size_t index;
+    const char *cursor;
+    bool is_lazy, is_greedy, is_boundary;
+} pattern_parser_t;
+
+typedef struct {
+    size_t accept, accept_boundary, live;
+    uint16_t next[256];
+} dfa_state_t;
+
+static size_t g_nfa_state_count = 0;
+static size_t g_nfa_state_capacity = 0;
+static nfa_state_t *g_nfa_states = nullptr;
+static size_t g_nfa_starts[SPEC_SIZE];
+
+static bool g_lazy[SPEC_SIZE];
+
+static size_t g_dfa_state_count = 0;
+static dfa_state_t *g_dfa_states = nullptr;
+
+static void set_add_range(uint64_t set[4], uint8_t from, uint8_t to) {
+    for(size_t ch = from; ch <= to; ch++) set[ch / 64] |= 1ULL << (ch % 64);
+}
+
+static bool set_has(const uint64_t set[4], uint8_t ch) {
+    return (set[ch / 64] >> (ch % 64)) & 1;
+}
+
+static bool is_word(uint8_t ch) {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_';
+}
+
+static size_t nfa_add(nfa_state_type_t type, size_t pattern) {
+    if(g_nfa_state_count == g_nfa_state_capacity) {
+        g_nfa_state_capacity = g_nfa_state_capacity == 0 ? 256 : g_nfa_state_capacity * 2;
+        g_nfa_states = reallocarray(g_nfa_states, g_nfa_state_capacity, sizeof(nfa_state_t));
+    }
+    g_nfa_states[g_nfa_state_count] = (nfa_state_t) { .type = type, .pattern = pattern, .out = { NONE, NONE } };
+    return g_nfa_state_count++;
+}
+
+static size_t nfa_add_set(size_t pattern, const uint64_t set[4], size_t out) {
+    size_t state = nfa_add(NFA_STATE_TYPE_SET, pattern);
+    memcpy(g_nfa_states[state].set, set, sizeof(g_nfa_states[state].set));
+    g_nfa_states[state].out[0] = out;
+    return state;
+}
+
+static size_t nfa_add_range(size_t pattern, uint8_t from, uint8_t to, size_t out) {
+    uint64_t set[4] = {};
+    set_add_range(set, from, to);
+    return nfa_add_set(pattern, set, out);
+}
+
+static size_t nfa_add_split(size_t pattern, size_t a, size_t b) {
+    size_t state = nfa_add(NFA_STATE_TYPE_EPSILON, pattern);
+    g_nfa_states[state].out[0] = a;
+    g_nfa_states[state].out[1] = b;
+    return state;
+}
+
+static nfa_fragment_t fragment_empty(pattern_parser_t *parser) {
+    size_t state = nfa_add(NFA_STATE_TYPE_EPSILON, parser->index);
+    return (nfa_fragment_t) { .start = state, .end = state };
+}
+
+static nfa_fragment_t fragment_concat(nfa_fragment_t a, nfa_fragment_t b) {
+    g_nfa_states[a.end].out[0] = b.start;
+    return (nfa_fragment_t) { .start = a.start, .end = b.end };
+}
+
+static nfa_fragment_t fragment_alternate(pattern_parser_t *parser, nfa_fragment_t a, nfa_fragment_t b) {
+    size_t end = nfa_add(NFA_STATE_TYPE_EPSILON, parser->index);
+    g_nfa_states[a.end].out[0] = end;
+    g_nfa_states[b.end].out[0] = end;
+    return (nfa_fragment_t) { .start = nfa_add_split(parser->index, a.start, b.start), .end = end };
+}
+
+static nfa_fragment_t fragment_class(pattern_parser_t *parser, const char_class_t *class, bool negated) {
+    class_nonascii_t nonascii = CLASS_NONASCII_NONE;
+    if(class->has_space || class->has_nonspace || class->has_unicode) nonascii = CLASS_NONASCII_UNICODE;
+    if(class->has_space && class->has_nonspace && !class->has_unicode) nonascii = CLASS_NONASCII_ALL;
+
+    uint64_t set[4] = { class->set[0], class->set[1], 0, 0 };
+    if(negated) {
+        set[0] = ~set[0];
+        set[1] = ~set[1];
+        if(nonascii != CLASS_NONASCII_UNICODE) nonascii = nonascii == CLASS_NONASCII_ALL ? CLASS_NONASCII_NONE : CLASS_NONASCII_ALL;
+    }
+
+    size_t end = nfa_add(NFA_STATE_TYPE_EPSILON, parser->index);
+    size_t start = nfa_add_set(parser->index, set, end);
+    switch(nonascii) {
+        case CLASS_NONASCII_NONE: break;
+        case CLASS_NONASCII_ALL:  {
+            // Any well formed multibyte sequence, a lead byte followed by its continuation bytes
+            size_t continuation1 = nfa_add_range(parser->index, 0x80, 0xBF, end);
+            size_t continuation2 = nfa_add_range(parser->index, 0x80, 0xBF, continuation1);
+            size_t continuation3 = nfa_add_range(parser->index, 0x80, 0xBF, continuation2);
+            size_t lead2 = nfa_add_range(parser->index, 0xC2, 0xDF, continuation1);
+            size_t lead3 = nfa_add_range(parser->index, 0xE0, 0xEF, continuation2);
+            size_t lead4 = nfa_add_range(parser->index, 0xF0, 0xF4, continuation3);
+            start = nfa_add_split(parser->index, start, nfa_add_split(parser->index, lead2, nfa_add_split(parser->index, lead3, lead4)));
+            break;
+        }
+        case CLASS_NONASCII_UNICODE: {
+            // Membership depends on unicode properties, leave the decision to the regex engine
+            size_t bail = nfa_add(NFA_STATE_TYPE_BAIL, parser->index);
+            start = nfa_add_split(parser->index, start, nfa_add_range(parser->index, 0xC2, 0xF4, bail));
+            break;
+        }
+    }
+    return (nfa_fragment_t) { .start = start, .end = end };
+}
+
+static char parse_escaped_char(pattern_parser_t *parser, char ch) {
+    switch(ch) {
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+    }
+    if(is_word(ch) || ch == '\0') fatal("unsupported escape '\\%c' in pattern '%s'", ch, g_spec[parser->index].pattern);
+    return ch;
+}
+
+static bool parse_class_escape(pattern_parser_t *parser, char_class_t *class) {
+    switch(parser->cursor[1]) {
+        case 'd':
+            set_add_range(class->set, '0', '9');
+            class->has_unicode = true;
+            break;
+        case 's':
+            set_add_range(class->set, '\t', '\r');
+            set_add_range(class->set, ' ', ' ');
+            class->has_space = true;
+            break;
+        case 'S':
+            set_add_range(class->set, 0, '\t' - 1);
+            set_add_range(class->set, '\r' + 1, ' ' - 1);
+            set_add_range(class->set, ' ' + 1, 0x7F);
+            class->has_nonspace = true;
+            break;
+        case 'p': {
+            const char *close = strchr(parser->cursor, '}');
+            if(parser->cursor[2] != '{' || close == nullptr) fatal("malformed property in pattern '%s'", g_spec[parser->index].pattern);
+            class->has_unicode = true;
+            parser->cursor = close + 1;
+            return true;
+        }
+        default: return false;
+    }
+    parser->cursor += 2;
+    return true;
+}
+
+static nfa_fragment_t parse_alternation(pattern_parser_t *parser);
+
+static nfa_fragment_t parse_class(pattern_parser_t *parser) {
+    char_class_t class = {};
+
+    parser->cursor++;
+    bool negated = *parser->cursor == '^';
+    if(negated) parser->cursor++;
+
+    while(*parser->cursor != ']') {
+        if(*parser->cursor == '\0') fatal("unterminated class in pattern '%s'", g_spec[parser->index].pattern);
+        if(*parser->cursor == '\\' && parse_class_escape(parser, &class)) continue;
+
+        uint8_t from = *parser->cursor == '\\' ? parse_escaped_char(parser, *++parser->cursor) : *parser->cursor;
+        parser->cursor++;
+
+        uint8_t to = from;
+        if(parser->cursor[0] == '-' && parser->cursor[1] != ']') {
+            parser->cursor++;
+            to = *parser->cursor == '\\' ? parse_escaped_char(parser, *++parser->cursor) : *parser->cursor;
+            parser->cursor++;
+        }
+        if(from > to || to > 0x7F) fatal("unsupported class range in pattern '%s'", g_spec[parser->index].pattern);
+        set_add_range(class.set, from, to);
+    }
+    parser->cursor++;
+
+    return fragment_class(parser, &class, negated);
+}
+
+static nfa_fragment_t parse_atom(pattern_parser_t *parser) {
+    switch(*parser->cursor) {
+        case '(': {
+            if(strncmp(parser->cursor, "(?:", 3) != 0) fatal("unsupported group in pattern '%s'", g_spec[parser->index].pattern);
+            parser->cursor += 3;
+            nfa_fragment_t fragment = parse_alternation(parser);
+            if(*parser->cursor != ')') fatal("unterminated group in pattern '%s'", g_spec[parser->index].pattern);
+            parser->cursor++;
+            return fragment;
+        }
+        case '[': return parse_class(parser);
+        case '.': {
+            char_class_t class = {};
+            set_add_range(class.set, '\n', '\n');
+            parser->cursor++;
+            return fragment_class(parser, &class, true);
+        }
+        case '\\': {
+            if(parser->cursor[1] == 'b') {
+                if(parser->cursor[2] != '\0') fatal("word boundary is only supported at the end of pattern '%s'", g_spec[parser->index].pattern);
+                parser->is_boundary = true;
+                parser->cursor += 2;
+                return fragment_empty(parser);
+            }
+
+            char_class_t class = {};
+            if(parse_class_escape(parser, &class)) return fragment_class(parser, &class, false);
+
+            uint8_t ch = parse_escaped_char(parser, parser->cursor[1]);
+            parser->cursor += 2;
+            set_add_range(class.set, ch, ch);
+            return fragment_class(parser, &class, false);
+        }
+        case '^':
+        case '$':
+        case '*':
+        case '+':
+        case '?': fatal("unsupported use of '%c' in pattern '%s'", *parser->cursor, g_spec[parser->index].pattern);
+    }
+
+    uint8_t ch = *parser->cursor++;
+    uint64_t set[4] = {};
+    set_add_range(set, ch, ch);
+
+    size_t end = nfa_add(NFA_STATE_TYPE_EPSILON, parser->index);
+    return (nfa_fragment_t) { .start = nfa_add_set(parser->index, set, end), .end = end };
+}
+
+static nfa_fragment_t parse_repeat(pattern_parser_t *parser) {
+    nfa_fragment_t fragment = parse_atom(parser);
+
+    char quantifier = *parser->cursor;
+    if(quantifier != '*' && quantifier != '+' && quantifier != '?') return fragment;
+    parser->cursor++;
+
+    if(*parser->cursor == '?') {
+        parser->is_lazy = true;
+        parser->cursor++;
+    } else {
+        parser->is_greedy = true;
+    }
+
+    size_t end = nfa_add(NFA_STATE_TYPE_EPSILON, parser->index);
+    size_t split = nfa_add_split(parser->index, fragment.start, end);
+    switch(quantifier) {
+        case '*': g_nfa_states[fragment.end].out[0] = split; return (nfa_fragment_t) { .start = split, .end = end };
+        case '+': g_nfa_states[fragment.end].out[0] = split; return (nfa_fragment_t) { .start = fragment.start, .end = end };
+        case '?': g_nfa_states[fragment.end].out[0] = end; return (nfa_fragment_t) { .start = split, .end = end };
+    }
+    assert(false);
+}
+
+static nfa_fragment_t parse_sequence(pattern_parser_t *parser) {
+    nfa_fragment_t fragment = fragment_empty(parser);
+    while(*parser->cursor != '\0' && *parser->cursor != ')' && *parser->cursor != '|') fragment = fragment_concat(fragment, parse_repeat(parser));
+    return fragment;
+}
+
+static nfa_fragment_t parse_alternation(pattern_parser_t *parser) {
+    nfa_fragment_t fragment = parse_sequence(parser);
+    while(*parser->cursor == '|') {
+        parser->cursor++;
+        fragment = fragment_alternate(parser, fragment, parse_sequence(parser));
+    }
+    return fragment;
+}
+
+static void nfa_compile_pattern(size_t index) {
+    pattern_parser_t parser = { .index = index, .cursor = g_spec[index].pattern };
+    if(*parser.cursor++ != '^') fatal("pattern '%s' is not anchored", g_spec[index].pattern);
+
+    nfa_fragment_t fragment = parse_alternation(&parser);
+    if(*parser.cursor != '\0') fatal("unbalanced group in pattern '%s'", g_spec[index].pattern);
+
+    // Lazy patterns are matched as the shortest match, which only equals the regex semantics without greedy parts
+    if(parser.is_lazy && parser.is_greedy) fatal("pattern '%s' mixes lazy and greedy quantifiers", g_spec[index].pattern);
+
+    size_t accept = nfa_add(NFA_STATE_TYPE_ACCEPT, index);
+    g_nfa_states[accept].boundary = parser.is_boundary;
+    g_nfa_states[fragment.end].out[0] = accept;
+
+    g_nfa_starts[index] = fragment.start;
+    g_lazy[index] = parser.is_lazy;
+}
+
+static int compare_state(const void *a, const void *b) {
+    size_t x = *(const size_t *) a, y = *(const size_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Computes the epsilon closure of `count` states in `stack` into a canonical set.
+ * Threads of a lazy pattern are dropped once it accepts, the first accept is its match.
+ */
+static nfa_set_t nfa_closure(size_t *stack, size_t count, bool *visited) {
+    nfa_set_t set = { .count = 0, .states = malloc(g_nfa_state_count * sizeof(size_t)) };
+
+    size_t *touched = malloc(g_nfa_state_count * sizeof(size_t));
+    size_t touched_count = 0;
+    while(count > 0) {
+        size_t state = stack[--count];
+        if(visited[state]) continue;
+        visited[state] = true;
+        touched[touched_count++] = state;
+
+        if(g_nfa_states[state].type != NFA_STATE_TYPE_EPSILON) {
+            set.states[set.count++] = state;
+            continue;
+        }
+        for(size_t i = 0; i < 2; i++) {
+            if(g_nfa_states[state].out[i] != NONE) stack[count++] = g_nfa_states[state].out[i];
+        }
+    }
+    for(size_t i = 0; i < touched_count; i++) visited[touched[i]] = false;
+    free(touched);
+
+    qsort(set.states, set.count, sizeof(size_t), compare_state);
+
+    size_t kept = 0;
+    for(size_t i = 0; i < set.count; i++) {
+        const nfa_state_t *state = &g_nfa_states[set.states[i]];
+        if(state->type == NFA_STATE_TYPE_SET && g_lazy[state->pattern]) {
+            bool accepted = false;
+            for(size_t j = 0; j < set.count; j++) {
+                if(g_nfa_states[set.states[j]].type == NFA_STATE_TYPE_ACCEPT && g_nfa_states[set.states[j]].pattern == state->pattern) accepted = true;
+            }
+            if(accepted) continue;
+        }
+        set.states[kept++] = set.states[i];
+    }
+    set.count = kept;
+
+    return set;
+}
+
+static uint64_t nfa_set_hash(nfa_set_t set) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for(size_t i = 0; i < set.count; i++) {
+        h ^= set.states[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static bool nfa_set_equal(nfa_set_t a, nfa_set_t b) {
+    return a.count == b.count && (a.count == 0 || memcmp(a.states, b.states, a.count * sizeof(size_t)) == 0);
+}
+
+static size_t table_find(const size_t *table, size_t table_capacity, const nfa_set_t *sets, nfa_set_t set) {
+    size_t slot = nfa_set_hash(set) & (table_capacity - 1);
+    while(table[slot] != NONE && !nfa_set_equal(sets[table[slot]], set)) slot = (slot + 1) & (table_capacity - 1);
+    return slot;
+}
+
+static void dfa_state_init(dfa_state_t *dfa_state, nfa_set_t set) {
+    dfa_state->accept = SPEC_SIZE;
+    dfa_state->accept_boundary = SPEC_SIZE;
+    dfa_state->live = SPEC_SIZE;
+    for(size_t i = 0; i < set.count; i++) {
+        const nfa_state_t *state = &g_nfa_states[set.states[i]];
+        switch(state->type) {
+            case NFA_STATE_TYPE_ACCEPT:
+                if(state->boundary) {
+                    if(state->pattern < dfa_state->accept_boundary) dfa_state->accept_boundary = state->pattern;
+                } else {
+                    if(state->pattern < dfa_state->accept) dfa_state->accept = state->pattern;
+                }
+                break;
+            case NFA_STATE_TYPE_SET:
+                if(state->pattern < dfa_state->live) dfa_state->live = state->pattern;
+                break;
+            case NFA_STATE_TYPE_BAIL:
+            case NFA_STATE_TYPE_EPSILON: break;
+        }
+    }
+}
+
+void dfa_compile() {
+    for(size_t i = 0; i < SPEC_SIZE; i++) nfa_compile_pattern(i);
+
+    bool *visited = calloc(g_nfa_state_count, sizeof(bool));
+    size_t *stack = malloc(g_nfa_state_count * 3 * sizeof(size_t));
+
+    size_t set_capacity = 64;
+    nfa_set_t *sets = malloc(set_capacity * sizeof(nfa_set_t));
+    g_dfa_states = malloc(set_capacity * sizeof(dfa_state_t));
+
+    size_t table_capacity = 256;
+    size_t *table = malloc(table_capacity * sizeof(size_t));
+    for(size_t i = 0; i < table_capacity; i++) table[i] = NONE;
+
+    sets[DFA_STATE_DEAD] = (nfa_set_t) { .count = 0, .states = nullptr };
+    memcpy(stack, g_nfa_starts, sizeof(g_nfa_starts));
+    sets[DFA_STATE_START] = nfa_closure(stack, SPEC_SIZE, visited);
+    g_dfa_state_count = 2;
+    for(size_t i = 0; i < g_dfa_state_count; i++) {
+        table[table_find(table, table_capacity, sets, sets[i])] = i;
+        dfa_state_init(&g_dfa_states[i], sets[i]);
+    }
+    memset(g_dfa_states[DFA_STATE_DEAD].next, DFA_STATE_DEAD, sizeof(g_dfa_states[DFA_STATE_DEAD].next));
+
+    for(size_t current = DFA_STATE_START; current < g_dfa_state_count; current++) {
+        for(size_t ch = 0; ch < 256; ch++) {
+            size_t count = 0;
+            for(size_t i = 0; i < sets[current].count; i++) {
+                const nfa_state_t *state = &g_nfa_states[sets[current].states[i]];
+                if(state->type == NFA_STATE_TYPE_SET && set_has(state->set, ch)) stack[count++] = state->out[0];
+            }
+
+            nfa_set_t set = nfa_closure(stack, count, visited);
+
+            bool bail = false;
+            for(size_t i = 0; i < set.count; i++) {
+                if(g_nfa_states[set.states[i]].type == NFA_STATE_TYPE_BAIL) bail = true;
+            }
+            if(bail) {
+                free(set.states);
+                g_dfa_states[current].next[ch] = DFA_STATE_BAIL;
+                continue;
+            }
+
+            size_t slot = table_find(table, table_capacity, sets, set);
+            if(table[slot] != NONE) {
+                free(set.states);
+                g_dfa_states[current].next[ch] = table[slot];
+                continue;
+            }
+
+            if(g_dfa_state_count == DFA_STATE_LIMIT) fatal("lexer dfa exceeds %d states", DFA_STATE_LIMIT);
+            if(g_dfa_state_count == set_capacity) {
+                set_capacity *= 2;
+                sets = reallocarray(sets, set_capacity, sizeof(nfa_set_t));
+                g_dfa_states = reallocarray(g_dfa_states, set_capacity, sizeof(dfa_state_t));
+            }
+
+            size_t new_state = g_dfa_state_count++;
+            sets[new_state] = set;
+            dfa_state_init(&g_dfa_states[new_state], set);
+            g_dfa_states[current].next[ch] = new_state;
+
+            table[slot] = new_state;
+            if(g_dfa_state_count * 2 > table_capacity) {
+                free(table);
+                table_capacity *= 2;
+                table = malloc(table_capacity * sizeof(size_t));
+                for(size_t i = 0; i < table_capacity; i++) table[i] = NONE;
+                for(size_t i = 0; i < g_dfa_state_count; i++) table[table_find(table, table_capacity, sets, sets[i])] = i;
+            }
+        }
+    }
+
+    for(size_t i = 0; i < g_dfa_state_count; i++) free(sets[i].states);
+    free(sets);
+    free(table);
+    free(stack);
+    free(visited);
+    free(g_nfa_states);
+    g_nfa_states = nullptr;
+    g_nfa_state_count = 0;
+    g_nfa_state_capacity = 0;
+}
+
+bool dfa_match(utf8_slice_t slice, spec_match_t *match) {
+    const uint8_t *data = &slice.text->data[slice.start_index];
+
+    size_t best = SPEC_SIZE;
+    size_t best_size = 0;
+    size_t lookahead = 0;
+
+    const dfa_state_t *state = &g_dfa_states[DFA_STATE_START];
+    size_t i = 0;
+    while(true) {
+        size_t accept = state->accept;
+        if(state->accept_boundary < accept && state->accept_boundary <= best) {
+            lookahead = i + 1;
+            if(i < slice.size && data[i] >= 0x80) return false;
+            if(i >= slice.size || !is_word(data[i])) accept = state->accept_boundary;
+        }
+
+        // Lazy patterns never accept twice, so extending an equal match is only ever greedy
+        if(accept < SPEC_SIZE && accept <= best) {
+            best = accept;
+            best_size = i;
+        }
+
+        // Running out of input while a pattern is live means the result depends on whatever would follow
+        if(i >= slice.size) {
+            if(state->live < SPEC_SIZE && state->live <= best) lookahead = i + 1;
+            break;
+        }
+        if(state->live > best) break;
+
+        uint16_t next = state->next[data[i++]];
+        if(next == DFA_STATE_BAIL) return false;
+        if(next == DFA_STATE_DEAD) break;
+        state = &g_dfa_states[next];
+    }
+    if(i > lookahead) lookahead = i;
+
+    if(best == SPEC_SIZE) {
+        *match = (spec_match_t) { .kind.is_trivia = false, .kind.token_kind = CHARON_TOKEN_KIND_UNKNOWN, .size = 0, .lookahead = lookahead };
+    } else {
+        *match = (spec_match_t) { .kind = g_spec[best].kind, .size = best_size, .lookahead = lookahead };
+    }
+    return true;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "common/utf8.h"
+#include "lexer/spec.h"
+
+/**
+ * Compile every pattern of the specification into one combined DFA.
+ * Fatal if a pattern uses regex syntax the DFA compiler does not understand.
+ */
+void dfa_compile();
+
+/**
+ * Match the specification against the start of a slice, scanning each byte once.
+ * Produces the same result as `spec_match`, the lookahead is the number of bytes the scan examined,
+ * one past the slice when the scan reached its end. Returns false when the result depends on
+ * unicode properties the DFA does not model, in which case the caller has to fall back to `spec_match`.
+ */
+bool dfa_match(utf8_slice_t slice, spec_match_t *match);
@@ -0,0 +1,454 @@
+#include "charon/lexer.h"
+
+#include "charon/element.h"
+#include "charon/token.h"
+#include "charon/trivia.h"
+#include "common/fatal.h"
+#include "common/utf8.h"
+#include "lexer/dfa.h"
+#include "lexer/spec.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef LEXER_DFA
+#define LEXER_DFA 1
+#endif
+
+#define REUSE_FRAMES_INITIAL_CAPACITY 16
+#define TRIVIA_INITIAL_CAPACITY 16
+
+typedef enum {
+    LEXER_MODE_FRESH,
+    LEXER_MODE_REUSE_PREFIX,
+    LEXER_MODE_RELEX,
+    LEXER_MODE_REUSE_SUFFIX
+} lexer_mode_t;
+
+typedef struct {
+    const charon_element_inner_t *node;
+    size_t index;
+} reuse_frame_t;
+
+struct charon_lexer {
+    charon_element_cache_t *cache;
+
+    const charon_utf8_text_t *text;
+
+    size_t cursor;
+    bool is_eof;
+    bool is_end_examined;
+
+    const charon_element_inner_t *lookahead;
+    bool is_lookahead_reused;
+
+    spec_matcher_t *matcher;
+
+    // trivia of the token being lexed, kept across tokens so a run of trivia does not reallocate per line
+    size_t trivia_count, trivia_capacity;
+    const charon_element_inner_t **trivia;
+    // the first trivia of the buffer that lead the next token, left over from the trailing trivia of the previous one
+    size_t cached_trivia_count;
+    bool cached_trivia_lookahead_past_line;
+
+    lexer_mode_t mode;
+    struct {
+        size_t restart_offset;
+        size_t edit_old_end, edit_new_end;
+        size_t root_end;
+
+        size_t offset;
+        size_t frame_count, frame_capacity;
+        reuse_frame_t *frames;
+    } reuse;
+};
+
+static pthread_once_t g_spec_once = PTHREAD_ONCE_INIT;
+
+static spec_match_t next_match(charon_lexer_t *lexer) {
+    utf8_slice_t slice = utf8_slice(lexer->text, lexer->cursor, lexer->text->size);
+
+    spec_match_t match;
+    if(LEXER_DFA && dfa_match(slice, &match)) return match;
+
+    if(lexer->matcher == nullptr) lexer->matcher = spec_matcher_make();
+    return spec_match(lexer->matcher, slice);
+}
+
+static bool is_eof(charon_lexer_t *lexer) {
+    return lexer->cursor >= lexer->text->size;
+}
+
+static const char *lexer_extract(charon_lexer_t *lexer, size_t length) {
+    const char *text = (const char *) &lexer->text->data[lexer->cursor];
+    lexer->cursor += length;
+    return text;
+}
+
+/**
+ * Record whether the match at the cursor wanted to examine text past the end of the text.
+ */
+static void match_track_end(charon_lexer_t *lexer, spec_match_t match) {
+    if(lexer->cursor + match.lookahead > lexer->text->size) lexer->is_end_examined = true;
+}
+
+/**
+ * Whether the match at the cursor examined text past a newline that follows the matched text.
+ */
+static bool match_lookahead_past_line(charon_lexer_t *lexer, spec_match_t match) {
+    if(match.lookahead <= match.size + 1) return false;
+    return memchr(&lexer->text->data[lexer->cursor + match.size], '\n', match.lookahead - match.size - 1) != nullptr;
+}
+
+static void trivia_push(charon_lexer_t *lexer, const charon_element_inner_t *trivia) {
+    if(lexer->trivia_count == lexer->trivia_capacity) {
+        lexer->trivia_capacity = lexer->trivia_capacity == 0 ? TRIVIA_INITIAL_CAPACITY : lexer->trivia_capacity * 2;
+        lexer->trivia = reallocarray(lexer->trivia, lexer->trivia_capacity, sizeof(charon_element_inner_t *));
+    }
+    lexer->trivia[lexer->trivia_count++] = trivia;
+}
+
+static const charon_element_inner_t *lex(charon_lexer_t *lexer) {
+    assert(lexer->trivia_count == lexer->cached_trivia_count);
+
+    size_t leading_trivia_count = 0, trailing_trivia_count = 0;
+    bool lookahead_past_line = lexer->cached_trivia_lookahead_past_line;
+
+    lexer->cached_trivia_count = 0;
+    lexer->cached_trivia_lookahead_past_line = false;
+
+    charon_token_kind_t token_kind;
+    const char *token_text;
+    size_t token_text_length;
+
+    spec_match_t match;
+    while(true) {
+        if(is_eof(lexer)) {
+            lexer->is_eof = true;
+            token_kind = CHARON_TOKEN_KIND_EOF;
+            token_text = nullptr;
+            token_text_length = 0;
+            leading_trivia_count = lexer->trivia_count;
+            goto exit;
+        }
+
+        match = next_match(lexer);
+        match_track_end(lexer, match);
+        if(match_lookahead_past_line(lexer, match)) lookahead_past_line = true;
+        if(match.size == 0 || !match.kind.is_trivia) break;
+
+        const char *text = lexer_extract(lexer, match.size);
+        trivia_push(lexer, charon_element_inner_make_trivia(lexer->cache, match.kind.trivia_kind, text, match.size));
+    }
+    leading_trivia_count = lexer->trivia_count;
+
+    assert(match.size == 0 || !match.kind.is_trivia);
+
+    if(match.size == 0) {
+        size_t char_length = charon_utf8_lead_width(lexer->text->data[lexer->cursor]);
+        if(char_length > lexer->text->size - lexer->cursor) fatal("lexer encountered truncated character sequence at the end of the file");
+
+        token_kind = CHARON_TOKEN_KIND_UNKNOWN;
+        token_text = lexer_extract(lexer, char_length);
+        token_text_length = char_length;
+    } else {
+        token_kind = match.kind.token_kind;
+        token_text = lexer_extract(lexer, match.size);
+        token_text_length = match.size;
+    }
+
+    while(true) {
+        if(is_eof(lexer)) goto consume_trailing;
+
+        match = next_match(lexer);
+        match_track_end(lexer, match);
+        if(match.size == 0 || !match.kind.is_trivia) {
+            lexer->cached_trivia_count = lexer->trivia_count - leading_trivia_count;
+            break;
+        }
+        if(match_lookahead_past_line(lexer, match)) lexer->cached_trivia_lookahead_past_line = true;
+
+        const char *text = lexer_extract(lexer, match.size);
+        trivia_push(lexer, charon_element_inner_make_trivia(lexer->cache, match.kind.trivia_kind, text, match.size));
+
+        if(match.kind.trivia_kind == CHARON_TRIVIA_KIND_NEWLINE) {
+        consume_trailing:
+            trailing_trivia_count = lexer->trivia_count - leading_trivia_count;
+            if(lexer->cached_trivia_lookahead_past_line) lookahead_past_line = true;
+            lexer->cached_trivia_lookahead_past_line = false;
+            break;
+        }
+    }
+
+exit:
+    const charon_element_inner_t *element = charon_element_inner_make_token(lexer->cache, token_kind, token_text, token_text_length, lookahead_past_line, leading_trivia_count, trailing_trivia_count, lexer->trivia);
+
+    // trivia not ended by a newline lead the next token, they move to the front of the buffer
+    if(lexer->cached_trivia_count > 0) memmove(lexer->trivia, &lexer->trivia[leading_trivia_count], lexer->cached_trivia_count * sizeof(charon_element_inner_t *));
+    lexer->trivia_count = lexer->cached_trivia_count;
+
+    return element;
+}
+
+static void reuse_push(charon_lexer_t *lexer, const charon_element_inner_t *node) {
+    if(lexer->reuse.frame_count == lexer->reuse.frame_capacity) {
+        lexer->reuse.frame_capacity = lexer->reuse.frame_capacity == 0 ? REUSE_FRAMES_INITIAL_CAPACITY : lexer->reuse.frame_capacity * 2;
+        lexer->reuse.frames = reallocarray(lexer->reuse.frames, lexer->reuse.frame_capacity, sizeof(reuse_frame_t));
+    }
+    lexer->reuse.frames[lexer->reuse.frame_count++] = (reuse_frame_t) { .node = node, .index = 0 };
+}
+
+/**
+ * Moves the old token cursor onto the first old token whose offset is at least `offset`,
+ * subtrees that end before `offset` are skipped without visiting their tokens.
+ * Returns the token, or nullptr when the old tokens are exhausted.
+ */
+static const charon_element_inner_t *reuse_seek(charon_lexer_t *lexer, size_t offset) {
+    while(lexer->reuse.frame_count > 0) {
+        reuse_frame_t *frame = &lexer->reuse.frames[lexer->reuse.frame_count - 1];
+        if(frame->index == charon_element_node_child_count(frame->node)) {
+            if(--lexer->reuse.frame_count > 0) lexer->reuse.frames[lexer->reuse.frame_count - 1].index++;
+            continue;
+        }
+
+        const charon_element_inner_t *child = charon_element_node_child(frame->node, frame->index);
+        size_t child_length = charon_element_length(child);
+        if(charon_element_type(child) == CHARON_ELEMENT_TYPE_TOKEN) {
+            if(lexer->reuse.offset >= offset) return child;
+        } else if(child_length == 0 || lexer->reuse.offset + child_length > offset) {
+            reuse_push(lexer, child);
+            continue;
+        }
+
+        lexer->reuse.offset += child_length;
+        frame->index++;
+    }
+    return nullptr;
+}
+
+static const charon_element_inner_t *reuse_take(charon_lexer_t *lexer) {
+    const charon_element_inner_t *token = reuse_seek(lexer, lexer->reuse.offset);
+    assert(token != nullptr);
+
+    lexer->reuse.offset += charon_element_length(token);
+    lexer->reuse.frames[lexer->reuse.frame_count - 1].index++;
+    if(charon_element_token_kind(token) == CHARON_TOKEN_KIND_EOF) lexer->is_eof = true;
+    lexer->is_lookahead_reused = true;
+    return token;
+}
+
+/**
+ * Called after a relexed token, checks whether the next token starts where an old token starts in unedited text.
+ * From there on lexing only depends on text that did not change, so the old tokens can be replayed as is.
+ */
+static bool reuse_resync(charon_lexer_t *lexer) {
+    size_t boundary = lexer->cursor;
+    for(size_t i = 0; i < lexer->cached_trivia_count; i++) boundary -= charon_element_length(lexer->trivia[i]);
+    if(boundary < lexer->reuse.edit_new_end) return false;
+
+    size_t old_boundary = boundary - lexer->reuse.edit_new_end + lexer->reuse.edit_old_end;
+    if(reuse_seek(lexer, old_boundary) == nullptr || lexer->reuse.offset != old_boundary) return false;
+
+    // The cached trivia are the leading trivia of the old token
+    lexer->trivia_count = 0;
+    lexer->cached_trivia_count = 0;
+    lexer->cached_trivia_lookahead_past_line = false;
+    return true;
+}
+
+/**
+ * Checks whether `offset` is the end of an old token whose trailing trivia end on their first newline.
+ * The token before such a boundary cannot be affected by text after it, making it a safe point to restart lexing.
+ */
+static bool is_line_boundary(const charon_element_inner_t *root, size_t offset) {
+    const charon_element_inner_t *element = root;
+    size_t element_offset = 0;
+    while(charon_element_type(element) == CHARON_ELEMENT_TYPE_NODE) {
+        size_t i = charon_element_node_child_at_offset(element, offset - 1 - element_offset);
+        if(i == charon_element_node_child_count(element)) return false;
+        element_offset += charon_element_node_child_offset(element, i);
+        element = charon_element_node_child(element, i);
+    }
+    if(element_offset + charon_element_length(element) != offset) return false;
+
+    size_t trailing_count = charon_element_token_trailing_trivia_count(element);
+    for(size_t i = 0; i < trailing_count; i++) {
+        bool is_newline = charon_element_trivia_kind(charon_element_token_trailing_trivia(element, i)) == CHARON_TRIVIA_KIND_NEWLINE;
+        if(is_newline) return i == trailing_count - 1;
+    }
+    return false;
+}
+
+/**
+ * Finds the offset of the first token before `limit` whose lexing looked past its line.
+ */
+static bool find_lookahead_past_line(const charon_element_inner_t *element, size_t offset, size_t limit, size_t *found_offset) {
+    if(offset >= limit || !charon_element_lookahead_past_line(element)) return false;
+    if(charon_element_type(element) == CHARON_ELEMENT_TYPE_TOKEN) {
+        *found_offset = offset;
+        return true;
+    }
+
+    for(size_t i = 0; i < charon_element_node_child_count(element); i++) {
+        const charon_element_inner_t *child = charon_element_node_child(element, i);
+        if(find_lookahead_past_line(child, offset, limit, found_offset)) return true;
+        offset += charon_element_length(child);
+    }
+    return false;
+}
+
+static size_t find_restart(const charon_utf8_text_t *text, const charon_element_inner_t *old_root, size_t offset) {
+    while(offset > 0) {
+        if(text->data[offset - 1] == '\n' && is_line_boundary(old_root, offset)) break;
+        offset--;
+    }
+    return offset;
+}
+
+static const charon_element_inner_t *next(charon_lexer_t *lexer) {
+    lexer->is_lookahead_reused = false;
+    switch(lexer->mode) {
+        case LEXER_MODE_FRESH: break;
+        case LEXER_MODE_REUSE_PREFIX:
+            if(lexer->reuse.offset < lexer->reuse.restart_offset) return reuse_take(lexer);
+            lexer->mode = LEXER_MODE_RELEX;
+            lexer->cursor = lexer->reuse.restart_offset;
+            [[fallthrough]];
+        case LEXER_MODE_RELEX: {
+            const charon_element_inner_t *element = lex(lexer);
+            if(!lexer->is_eof && reuse_resync(lexer)) lexer->mode = LEXER_MODE_REUSE_SUFFIX;
+            return element;
+        }
+        case LEXER_MODE_REUSE_SUFFIX:
+            if(reuse_seek(lexer, lexer->reuse.offset) != nullptr) return reuse_take(lexer);
+
+            // The old tokens of a subtree do not include the end of file, text past the subtree is lexed from scratch
+            lexer->mode = LEXER_MODE_FRESH;
+            lexer->cursor = lexer->reuse.root_end;
+            break;
+    }
+    return lex(lexer);
+}
+
+/**
+ * Compiles the specification, runs once per process so lexers can be made on any thread.
+ */
+static void spec_init() {
+    spec_compile();
+    if(LEXER_DFA) dfa_compile();
+}
+
+static charon_lexer_t *lexer_make(charon_element_cache_t *element_cache, const charon_utf8_text_t *text) {
+    assert(element_cache != nullptr);
+
+    pthread_once(&g_spec_once, spec_init);
+
+    charon_lexer_t *lexer = malloc(sizeof(charon_lexer_t));
+    lexer->cache = element_cache;
+    lexer->text = text;
+    lexer->cursor = 0;
+    lexer->is_eof = false;
+    lexer->is_end_examined = false;
+    lexer->is_lookahead_reused = false;
+    lexer->trivia_count = 0;
+    lexer->trivia_capacity = 0;
+    lexer->trivia = nullptr;
+    lexer->cached_trivia_count = 0;
+    lexer->cached_trivia_lookahead_past_line = false;
+    lexer->matcher = nullptr;
+    lexer->mode = LEXER_MODE_FRESH;
+    lexer->reuse.offset = 0;
+    lexer->reuse.frame_count = 0;
+    lexer->reuse.frame_capacity = 0;
+    lexer->reuse.frames = nullptr;
+    return lexer;
+}
+
+charon_lexer_t *charon_lexer_make(charon_element_cache_t *element_cache, const charon_utf8_text_t *text) {
+    charon_lexer_t *lexer = lexer_make(element_cache, text);
+    lexer->lookahead = next(lexer);
+    return lexer;
+}
+
+charon_lexer_t *charon_lexer_make_incremental(charon_element_cache_t *element_cache, const charon_utf8_text_t *text, const charon_element_inner_t *old_root, size_t edit_offset, size_t edit_old_length, size_t edit_new_length) {
+    assert(charon_element_type(old_root) == CHARON_ELEMENT_TYPE_NODE);
+    size_t root_end = charon_element_length(old_root) - edit_old_length + edit_new_length;
+    assert(edit_offset + edit_new_length <= root_end && root_end <= text->size);
+
+    charon_lexer_t *lexer = lexer_make(element_cache, text);
+
+    // Restart on the closest line the edit cannot have affected, earlier tokens that looked past their line might have seen the edit
+    size_t restart_offset = find_restart(text, old_root, edit_offset);
+    size_t lookahead_offset;
+    if(find_lookahead_past_line(old_root, 0, restart_offset, &lookahead_offset)) restart_offset = find_restart(text, old_root, lookahead_offset);
+
+    lexer->mode = LEXER_MODE_REUSE_PREFIX;
+    lexer->reuse.restart_offset = restart_offset;
+    lexer->reuse.edit_old_end = edit_offset + edit_old_length;
+    lexer->reuse.edit_new_end = edit_offset + edit_new_length;
+    lexer->reuse.root_end = root_end;
+    reuse_push(lexer, old_root);
+
+    lexer->lookahead = next(lexer);
+    return lexer;
+}
+
+void charon_lexer_destroy(charon_lexer_t *lexer) {
+    assert(lexer != nullptr);
+
+    if(lexer->matcher != nullptr) spec_matcher_destroy(lexer->matcher);
+    free(lexer->trivia);
+    free(lexer->reuse.frames);
+    free(lexer);
+}
+
+const charon_element_inner_t *charon_lexer_peek(charon_lexer_t *lexer) {
+    return lexer->lookahead;
+}
+
+const charon_element_inner_t *charon_lexer_advance(charon_lexer_t *lexer) {
+    const charon_element_inner_t *element = charon_lexer_peek(lexer);
+    if(!charon_lexer_is_eof(lexer)) lexer->lookahead = next(lexer);
+    return element;
+}
+
+bool charon_lexer_is_eof(charon_lexer_t *lexer) {
+    return lexer->is_eof;
+}
+
+bool charon_lexer_is_end_examined(charon_lexer_t *lexer) {
+    return lexer->is_end_examined;
+}
+
+const charon_element_inner_t *charon_lexer_reuse_node(charon_lexer_t *lexer, charon_node_kind_t kind) {
+    if(!lexer->is_lookahead_reused) return nullptr;
+
+    // The frames still point at the lookahead, an ancestor starts with it while it is the first child all the way down
+    size_t depth = lexer->reuse.frame_count - 1;
+    if(lexer->reuse.frames[depth].index != 1) return nullptr;
+    while(depth > 0) {
+        const charon_element_inner_t *node = lexer->reuse.frames[depth].node;
+        if(charon_element_node_kind(node) == kind) break;
+        if(lexer->reuse.frames[--depth].index != 0) return nullptr;
+    }
+    if(depth == 0) return nullptr;
+
+    const charon_element_inner_t *node = lexer->reuse.frames[depth].node;
+    if(charon_element_has_error(node)) return nullptr;
+
+    // Before the edit the token following the node has to be replayed as well, it is the lookahead the node was parsed with
+    size_t offset = lexer->reuse.offset - charon_element_length(lexer->lookahead);
+    size_t end = offset + charon_element_length(node);
+    if(lexer->mode == LEXER_MODE_REUSE_PREFIX && end >= lexer->reuse.restart_offset) return nullptr;
+    assert(lexer->mode == LEXER_MODE_REUSE_PREFIX || lexer->mode == LEXER_MODE_REUSE_SUFFIX);
+
+    lexer->reuse.frame_count = depth;
+    lexer->reuse.frames[depth - 1].index++;
+    lexer->reuse.offset = end;
+    lexer->lookahead = next(lexer);
+    return node;
+}
@@ -0,0 +1,132 @@
+#include "spec.h"
+
+#include "charon/token.h"
+#include "charon/trivia.h"
+#include "common/fatal.h"
+#include "common/utf8.h"
+
+#include <assert.h>
+#include <pcre2.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef LEXER_JIT
+#define LEXER_JIT 1
+#endif
+
+#define JIT_STACK_START_SIZE (32 * 1024)
+#define JIT_STACK_MAX_SIZE (512 * 1024)
+
+static_assert(SPEC_SIZE <= UINT8_MAX, "spec indexes must fit the candidate table");
+
+typedef struct {
+    pcre2_code *code;
+    bool is_jit;
+} spec_pattern_t;
+
+typedef struct {
+    size_t count;
+    uint8_t indexes[SPEC_SIZE];
+} spec_candidates_t;
+
+struct spec_matcher {
+    pcre2_match_data *match_data;
+    pcre2_match_context *match_context;
+    pcre2_jit_stack *jit_stack;
+};
+
+const spec_entry_t g_spec[SPEC_SIZE] = {
+#define TRIVIA(ID, _1, PATTERN) [SPEC_INDEX_TRIVIA_##ID] = { .kind.is_trivia = true, .kind.trivia_kind = CHARON_TRIVIA_KIND_##ID, .pattern = PATTERN },
+#include "charon/trivia.def"
+#undef TRIVIA
+#define TOKEN(ID, _1, PATTERN) [SPEC_INDEX_TOKEN_##ID] = { .kind.is_trivia = false, .kind.token_kind = CHARON_TOKEN_KIND_##ID, .pattern = PATTERN },
+#include "charon/tokens.def"
+#undef TOKEN
+};
+
+static spec_pattern_t g_spec_patterns[SPEC_SIZE];
+static spec_candidates_t g_spec_candidates[256];
+
+[[noreturn]] static void spec_fatal(const char *fmt, size_t index, int error_code) {
+    char error_message[120];
+    pcre2_get_error_message(error_code, (uint8_t *) error_message, 120);
+    fatal(fmt, g_spec[index].pattern, error_message);
+}
+
+static int pattern_match(const spec_pattern_t *pattern, const uint8_t *data, size_t size, pcre2_match_data *match_data, pcre2_match_context *match_context) {
+    if(pattern->is_jit) return pcre2_jit_match(pattern->code, data, size, 0, 0, match_data, match_context);
+    return pcre2_match(pattern->code, data, size, 0, PCRE2_NO_UTF_CHECK, match_data, match_context);
+}
+
+/**
+ * Builds the table of patterns that can match a subject starting with a given byte.
+ * A pattern is a candidate for an ascii byte when it matches or partially matches that byte alone,
+ * bytes that start a multibyte sequence keep every pattern.
+ */
+static void candidates_build() {
+    pcre2_match_data *match_data = pcre2_match_data_create(1, nullptr);
+    for(size_t ch = 0; ch < 256; ch++) {
+        spec_candidates_t *candidates = &g_spec_candidates[ch];
+        candidates->count = 0;
+        for(size_t i = 0; i < SPEC_SIZE; i++) {
+            if(ch < 0x80) {
+                uint8_t subject = ch;
+                int result = pcre2_match(g_spec_patterns[i].code, &subject, 1, 0, PCRE2_PARTIAL_HARD, match_data, nullptr);
+                if(result == PCRE2_ERROR_NOMATCH) continue;
+                if(result < 0 && result != PCRE2_ERROR_PARTIAL) spec_fatal("error building candidates for '%s' (%s)", i, result);
+            }
+            candidates->indexes[candidates->count++] = i;
+        }
+    }
+    pcre2_match_data_free(match_data);
+}
+
+void spec_compile() {
+    for(size_t i = 0; i < SPEC_SIZE; i++) {
+        int error_code;
+        PCRE2_SIZE error_offset;
+        pcre2_code *code = pcre2_compile((const uint8_t *) g_spec[i].pattern, PCRE2_ZERO_TERMINATED, PCRE2_UTF | PCRE2_UCP, &error_code, &error_offset, nullptr);
+        if(code == nullptr) spec_fatal("failed compiling pattern '%s' (%s)", i, error_code);
+
+        // JIT support is optional in PCRE2, patterns that fail to compile stay on the interpreter
+        g_spec_patterns[i] = (spec_pattern_t) { .code = code, .is_jit = LEXER_JIT && pcre2_jit_compile(code, PCRE2_JIT_COMPLETE) == 0 };
+    }
+    candidates_build();
+}
+
+spec_matcher_t *spec_matcher_make() {
+    spec_matcher_t *matcher = malloc(sizeof(spec_matcher_t));
+    matcher->match_data = pcre2_match_data_create(1, nullptr);
+    matcher->match_context = nullptr;
+    matcher->jit_stack = nullptr;
+    if(LEXER_JIT) {
+        matcher->match_context = pcre2_match_context_create(nullptr);
+        matcher->jit_stack = pcre2_jit_stack_create(JIT_STACK_START_SIZE, JIT_STACK_MAX_SIZE, nullptr);
+        if(matcher->jit_stack != nullptr) pcre2_jit_stack_assign(matcher->match_context, nullptr, matcher->jit_stack);
+    }
+    return matcher;
+}
+
+void spec_matcher_destroy(spec_matcher_t *matcher) {
+    if(matcher->jit_stack != nullptr) pcre2_jit_stack_free(matcher->jit_stack);
+    if(matcher->match_context != nullptr) pcre2_match_context_free(matcher->match_context);
+    pcre2_match_data_free(matcher->match_data);
+    free(matcher);
+}
+
+spec_match_t spec_match(spec_matcher_t *matcher, utf8_slice_t slice) {
+    const uint8_t *data = &slice.text->data[slice.start_index];
+    const spec_candidates_t *candidates = &g_spec_candidates[slice.size == 0 ? 0 : data[0]];
+    for(size_t i = 0; i < candidates->count; i++) {
+        size_t index = candidates->indexes[i];
+        int match_count = pattern_match(&g_spec_patterns[index], data, slice.size, matcher->match_data, matcher->match_context);
+        if(match_count <= 0) continue;
+
+        PCRE2_SIZE size;
+        int error_code = pcre2_substring_length_bynumber(matcher->match_data, 0, &size);
+        if(error_code != 0) spec_fatal("error during spec matching '%s' (%s)", index, error_code);
+        return (spec_match_t) { .kind = g_spec[index].kind, .size = size, .lookahead = slice.size + 1 };
+    }
+    return (spec_match_t) { .kind.is_trivia = false, .kind.token_kind = CHARON_TOKEN_KIND_UNKNOWN, .size = 0, .lookahead = slice.size + 1 };
+}
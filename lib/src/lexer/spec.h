@@ -0,0 +1,63 @@
+#pragma once
+
+#include "charon/token.h"
+#include "charon/trivia.h"
+#include "common/utf8.h"
+
+#include <stddef.h>
+
+enum {
+#define TRIVIA(ID, ...) SPEC_INDEX_TRIVIA_##ID,
+#include "charon/trivia.def"
+#undef TRIVIA
+#define TOKEN(ID, ...) SPEC_INDEX_TOKEN_##ID,
+#include "charon/tokens.def"
+#undef TOKEN
+    SPEC_SIZE
+};
+
+typedef struct {
+    bool is_trivia;
+    union {
+        charon_token_kind_t token_kind;
+        charon_trivia_kind_t trivia_kind;
+    };
+} lexer_token_kind_t;
+
+typedef struct {
+    const char *pattern;
+    lexer_token_kind_t kind;
+} spec_entry_t;
+
+typedef struct {
+    lexer_token_kind_t kind;
+    size_t size;
+    size_t lookahead;
+} spec_match_t;
+
+typedef struct spec_matcher spec_matcher_t;
+
+/**
+ * The lexer specification in priority order, trivia first followed by tokens.
+ * The first entry that matches at a position wins, regardless of match length.
+ */
+extern const spec_entry_t g_spec[SPEC_SIZE];
+
+/**
+ * Compile the regex patterns of the specification.
+ * Patterns are JIT compiled when built with `LEXER_JIT` and supported by PCRE2.
+ */
+void spec_compile();
+
+/**
+ * Create the per lexer matching state (match data and JIT stack).
+ */
+spec_matcher_t *spec_matcher_make();
+void spec_matcher_destroy(spec_matcher_t *matcher);
+
+/**
+ * Match the specification against the start of a slice using the regex patterns.
+ * Only patterns that can start with the first byte of the slice are attempted.
+ * The regex engine does not report how much of the slice it examined, so the lookahead is the whole slice and its end.
+ */
+spec_match_t spec_match(spec_matcher_t *matcher, utf8_slice_t slice);
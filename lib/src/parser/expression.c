@@ -4,31 +4,68 @@
 #include "parse.h"
 #include "parser/parser.h"
 
-#include <stdarg.h>
-#include <string.h>
-
-static void helper_binary_operation(charon_parser_t *parser, void (*func)(charon_parser_t *), size_t count, ...) {
-    parser_event_t *checkpoint = parser_checkpoint(parser);
-    func(parser);
-
-    va_list list;
-    va_start(list, count);
-    while(parser_consume_try_many_list(parser, count, list)) {
-        func(parser);
-
-        parser_open_element_at(parser, checkpoint);
-        parser_close_element(parser, CHARON_NODE_KIND_EXPR_BINARY);
-
-        va_end(list);
-        va_start(list, count);
-    }
-    va_end(list);
-}
+#define T(KIND) PARSER_TOKEN_SET(CHARON_TOKEN_KIND_##KIND)
+
+#define NUMERIC_LITERALS(X) X(LITERAL_NUMBER_BIN) X(LITERAL_NUMBER_DEC) X(LITERAL_NUMBER_OCT) X(LITERAL_NUMBER_HEX)
+#define STRING_LITERALS(X) X(LITERAL_STRING) X(LITERAL_STRING_RAW)
+#define PRIMARY_START(X) X(IDENTIFIER) X(LITERAL_STRING) X(LITERAL_STRING_RAW) X(LITERAL_CHAR) X(LITERAL_BOOL) X(LITERAL_NUMBER_DEC) X(LITERAL_NUMBER_HEX) X(LITERAL_NUMBER_OCT) X(LITERAL_NUMBER_BIN)
+
+static const parser_token_list_t g_numeric_literals = PARSER_TOKEN_LIST(NUMERIC_LITERALS);
+static const parser_token_list_t g_string_literals = PARSER_TOKEN_LIST(STRING_LITERALS);
+static const parser_token_list_t g_primary_start = PARSER_TOKEN_LIST(PRIMARY_START);
+static const parser_token_set_t g_unary_operators = T(PNCT_STAR) | T(PNCT_MINUS) | T(PNCT_NOT) | T(PNCT_AMPERSAND);
+
+typedef enum {
+    PRECEDENCE_NONE,
+    PRECEDENCE_ASSIGNMENT,
+    PRECEDENCE_LOGICAL_OR,
+    PRECEDENCE_LOGICAL_AND,
+    PRECEDENCE_BITWISE_OR,
+    PRECEDENCE_BITWISE_XOR,
+    PRECEDENCE_BITWISE_AND,
+    PRECEDENCE_EQUALITY,
+    PRECEDENCE_COMPARISON,
+    PRECEDENCE_SHIFT,
+    PRECEDENCE_TERM,
+    PRECEDENCE_FACTOR
+} precedence_t;
+
+typedef struct {
+    precedence_t precedence;
+    bool right_associative;
+} binary_operator_t;
+
+static const binary_operator_t g_binary_operators[CHARON_TOKEN_KIND_COUNT] = {
+    [CHARON_TOKEN_KIND_PNCT_EQUAL] = { PRECEDENCE_ASSIGNMENT, true },
+    [CHARON_TOKEN_KIND_PNCT_PLUS_EQUAL] = { PRECEDENCE_ASSIGNMENT, true },
+    [CHARON_TOKEN_KIND_PNCT_MINUS_EQUAL] = { PRECEDENCE_ASSIGNMENT, true },
+    [CHARON_TOKEN_KIND_PNCT_STAR_EQUAL] = { PRECEDENCE_ASSIGNMENT, true },
+    [CHARON_TOKEN_KIND_PNCT_SLASH_EQUAL] = { PRECEDENCE_ASSIGNMENT, true },
+    [CHARON_TOKEN_KIND_PNCT_PERCENTAGE_EQUAL] = { PRECEDENCE_ASSIGNMENT, true },
+    [CHARON_TOKEN_KIND_PNCT_LOGICAL_OR] = { PRECEDENCE_LOGICAL_OR, false },
+    [CHARON_TOKEN_KIND_PNCT_LOGICAL_AND] = { PRECEDENCE_LOGICAL_AND, false },
+    [CHARON_TOKEN_KIND_PNCT_PIPE] = { PRECEDENCE_BITWISE_OR, false },
+    [CHARON_TOKEN_KIND_PNCT_CARET] = { PRECEDENCE_BITWISE_XOR, false },
+    [CHARON_TOKEN_KIND_PNCT_AMPERSAND] = { PRECEDENCE_BITWISE_AND, false },
+    [CHARON_TOKEN_KIND_PNCT_EQUAL_EQUAL] = { PRECEDENCE_EQUALITY, false },
+    [CHARON_TOKEN_KIND_PNCT_NOT_EQUAL] = { PRECEDENCE_EQUALITY, false },
+    [CHARON_TOKEN_KIND_PNCT_CARET_RIGHT] = { PRECEDENCE_COMPARISON, false },
+    [CHARON_TOKEN_KIND_PNCT_GREATER_EQUAL] = { PRECEDENCE_COMPARISON, false },
+    [CHARON_TOKEN_KIND_PNCT_CARET_LEFT] = { PRECEDENCE_COMPARISON, false },
+    [CHARON_TOKEN_KIND_PNCT_LESS_EQUAL] = { PRECEDENCE_COMPARISON, false },
+    [CHARON_TOKEN_KIND_PNCT_SHIFT_LEFT] = { PRECEDENCE_SHIFT, false },
+    [CHARON_TOKEN_KIND_PNCT_SHIFT_RIGHT] = { PRECEDENCE_SHIFT, false },
+    [CHARON_TOKEN_KIND_PNCT_PLUS] = { PRECEDENCE_TERM, false },
+    [CHARON_TOKEN_KIND_PNCT_MINUS] = { PRECEDENCE_TERM, false },
+    [CHARON_TOKEN_KIND_PNCT_STAR] = { PRECEDENCE_FACTOR, false },
+    [CHARON_TOKEN_KIND_PNCT_SLASH] = { PRECEDENCE_FACTOR, false },
+    [CHARON_TOKEN_KIND_PNCT_PERCENTAGE] = { PRECEDENCE_FACTOR, false },
+};
 
 static void parse_numeric_literal(charon_parser_t *parser) {
     parser_open_element(parser);
 
-    parser_consume_many(parser, 4, CHARON_TOKEN_KIND_LITERAL_NUMBER_BIN, CHARON_TOKEN_KIND_LITERAL_NUMBER_DEC, CHARON_TOKEN_KIND_LITERAL_NUMBER_OCT, CHARON_TOKEN_KIND_LITERAL_NUMBER_HEX);
+    parser_consume_list(parser, &g_numeric_literals);
 
     parser_close_element(parser, CHARON_NODE_KIND_EXPR_LITERAL_NUMERIC);
 }
@@ -36,7 +73,7 @@ static void parse_numeric_literal(charon_parser_t *parser) {
 static void parse_string_literal(charon_parser_t *parser) {
     parser_open_element(parser);
 
-    parser_consume_many(parser, 2, CHARON_TOKEN_KIND_LITERAL_STRING, CHARON_TOKEN_KIND_LITERAL_STRING_RAW);
+    parser_consume_list(parser, &g_string_literals);
 
     parser_close_element(parser, CHARON_NODE_KIND_EXPR_LITERAL_STRING);
 }
@@ -123,25 +160,12 @@ static void parse_primary(charon_parser_t *parser) {
         case CHARON_TOKEN_KIND_LITERAL_NUMBER_HEX:
         case CHARON_TOKEN_KIND_LITERAL_NUMBER_OCT:
         case CHARON_TOKEN_KIND_LITERAL_NUMBER_BIN: parse_numeric_literal(parser); break;
-        default:                                   {
-            charon_token_kind_t kinds[9] = {
-                CHARON_TOKEN_KIND_IDENTIFIER,         CHARON_TOKEN_KIND_LITERAL_STRING,     CHARON_TOKEN_KIND_LITERAL_STRING_RAW, CHARON_TOKEN_KIND_LITERAL_CHAR,       CHARON_TOKEN_KIND_LITERAL_BOOL,
-                CHARON_TOKEN_KIND_LITERAL_NUMBER_DEC, CHARON_TOKEN_KIND_LITERAL_NUMBER_HEX, CHARON_TOKEN_KIND_LITERAL_NUMBER_OCT, CHARON_TOKEN_KIND_LITERAL_NUMBER_BIN,
-            };
-
-            charon_diag_data_t *diag_data = malloc(sizeof(charon_diag_data_t) + sizeof(kinds));
-            diag_data->unexpected_token.found = parser_peek(parser);
-            diag_data->unexpected_token.expected_count = sizeof(kinds) / sizeof(kinds[0]);
-            memcpy(&diag_data->unexpected_token.expected, kinds, sizeof(kinds));
-
-            parser_error(parser, CHARON_DIAG_UNEXPECTED_TOKEN, diag_data);
-            break;
-        }
+        default:                                   parser_error_expected(parser, &g_primary_start); break;
     }
 }
 
 static void parse_unary_post(charon_parser_t *parser) {
-    parser_event_t *checkpoint = parser_checkpoint(parser);
+    parser_checkpoint_t checkpoint = parser_checkpoint(parser);
 
     parse_primary(parser);
 
@@ -205,9 +229,9 @@ repeat:
 }
 
 static void parse_unary_pre(charon_parser_t *parser) {
-    parser_event_t *checkpoint = parser_checkpoint(parser);
+    parser_checkpoint_t checkpoint = parser_checkpoint(parser);
 
-    if(parser_consume_try_many(parser, 4, CHARON_TOKEN_KIND_PNCT_STAR, CHARON_TOKEN_KIND_PNCT_MINUS, CHARON_TOKEN_KIND_PNCT_NOT, CHARON_TOKEN_KIND_PNCT_AMPERSAND)) {
+    if(parser_consume_try_set(parser, g_unary_operators)) {
         parser_open_element_at(parser, checkpoint);
         parse_unary_pre(parser);
         parser_close_element(parser, CHARON_NODE_KIND_EXPR_UNARY);
@@ -216,67 +240,26 @@ static void parse_unary_pre(charon_parser_t *parser) {
     }
 }
 
-static void parse_factor(charon_parser_t *parser) {
-    helper_binary_operation(parser, parse_unary_pre, 3, CHARON_TOKEN_KIND_PNCT_STAR, CHARON_TOKEN_KIND_PNCT_SLASH, CHARON_TOKEN_KIND_PNCT_PERCENTAGE);
-}
-
-static void parse_term(charon_parser_t *parser) {
-    helper_binary_operation(parser, parse_factor, 2, CHARON_TOKEN_KIND_PNCT_PLUS, CHARON_TOKEN_KIND_PNCT_MINUS);
-}
-
-static void parse_shift(charon_parser_t *parser) {
-    helper_binary_operation(parser, parse_term, 2, CHARON_TOKEN_KIND_PNCT_SHIFT_LEFT, CHARON_TOKEN_KIND_PNCT_SHIFT_RIGHT);
-}
-
-static void parse_comparison(charon_parser_t *parser) {
-    helper_binary_operation(parser, parse_shift, 4, CHARON_TOKEN_KIND_PNCT_CARET_RIGHT, CHARON_TOKEN_KIND_PNCT_GREATER_EQUAL, CHARON_TOKEN_KIND_PNCT_CARET_LEFT, CHARON_TOKEN_KIND_PNCT_LESS_EQUAL);
-}
+/**
+ * Precedence climbing over `g_binary_operators`, parses operators binding at least as tight as `min_precedence`.
+ * Every operator wraps everything parsed since the checkpoint, so left associative chains nest to the left.
+ */
+static void parse_binary(charon_parser_t *parser, precedence_t min_precedence) {
+    parser_checkpoint_t checkpoint = parser_checkpoint(parser);
 
-static void parse_equality(charon_parser_t *parser) {
-    helper_binary_operation(parser, parse_comparison, 2, CHARON_TOKEN_KIND_PNCT_EQUAL_EQUAL, CHARON_TOKEN_KIND_PNCT_NOT_EQUAL);
-}
+    parse_unary_pre(parser);
+    while(true) {
+        binary_operator_t operator = g_binary_operators[parser_peek(parser)];
+        if(operator.precedence == PRECEDENCE_NONE || operator.precedence < min_precedence) break;
 
-static void parse_bitwise_and(charon_parser_t *parser) {
-    helper_binary_operation(parser, parse_equality, 1, CHARON_TOKEN_KIND_PNCT_AMPERSAND);
-}
-
-static void parse_bitwise_xor(charon_parser_t *parser) {
-    helper_binary_operation(parser, parse_bitwise_and, 1, CHARON_TOKEN_KIND_PNCT_CARET);
-}
-
-static void parse_bitwise_or(charon_parser_t *parser) {
-    helper_binary_operation(parser, parse_bitwise_xor, 1, CHARON_TOKEN_KIND_PNCT_PIPE);
-}
-
-static void parse_logical_and(charon_parser_t *parser) {
-    helper_binary_operation(parser, parse_bitwise_or, 1, CHARON_TOKEN_KIND_PNCT_LOGICAL_AND);
-}
-
-static void parse_logical_or(charon_parser_t *parser) {
-    helper_binary_operation(parser, parse_logical_and, 1, CHARON_TOKEN_KIND_PNCT_LOGICAL_OR);
-}
+        parser_consume(parser, parser_peek(parser));
+        parse_binary(parser, operator.right_associative ? operator.precedence : operator.precedence + 1);
 
-static void parse_assignment(charon_parser_t *parser) {
-    parser_event_t *checkpoint = parser_checkpoint(parser);
-
-    parse_logical_or(parser);
-    if(parser_consume_try_many(
-           parser,
-           6,
-           CHARON_TOKEN_KIND_PNCT_EQUAL,
-           CHARON_TOKEN_KIND_PNCT_PLUS_EQUAL,
-           CHARON_TOKEN_KIND_PNCT_MINUS_EQUAL,
-           CHARON_TOKEN_KIND_PNCT_STAR_EQUAL,
-           CHARON_TOKEN_KIND_PNCT_SLASH_EQUAL,
-           CHARON_TOKEN_KIND_PNCT_PERCENTAGE_EQUAL
-       ))
-    {
         parser_open_element_at(parser, checkpoint);
-        parse_assignment(parser);
         parser_close_element(parser, CHARON_NODE_KIND_EXPR_BINARY);
     }
 }
 
 void parse_expr(charon_parser_t *parser) {
-    parse_assignment(parser);
+    parse_binary(parser, PRECEDENCE_ASSIGNMENT);
 }
@@ -0,0 +1,270 @@
+#include "charon/diag.h"
+#include "charon/element.h"
+#include "charon/lexer.h"
+#include "charon/node.h"
+#include "charon/parser.h"
+#include "charon/path.h"
+#include "charon/utf8.h"
+#include "common/utf8.h"
+#include "parser/parse.h"
+#include "parser/parser.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK_MIN_SIZE (16 * 1024)
+#define CHUNKS_PER_THREAD 4
+
+typedef struct {
+    size_t start, end;
+
+    // the chunk parsed on its own, its top level items under a root node that holds the end of file token only for the last chunk
+    charon_parser_output_t output;
+
+    // whether the parse never looked at where the chunk ends, so its items are the ones the whole text has in place
+    bool is_exact;
+} chunk_t;
+
+typedef struct {
+    charon_element_cache_t *cache;
+    const charon_utf8_text_t *text;
+    chunk_t *chunks;
+    size_t chunk_count;
+    atomic_size_t next_chunk;
+} chunk_queue_t;
+
+static bool is_identifier_byte(uint8_t ch) {
+    return ch == '_' || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch >= 0x80;
+}
+
+/**
+ * Whether the keyword of a top level item starts at `index`.
+ */
+static bool is_tlc_keyword(const charon_utf8_text_t *text, size_t index) {
+    static const char *keywords[] = { "module", "fn", "extern", "type", "let", "enum" };
+    for(size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+        size_t length = strlen(keywords[i]);
+        if(index + length > text->size || memcmp(&text->data[index], keywords[i], length) != 0) continue;
+        if(index + length < text->size && is_identifier_byte(text->data[index + length])) continue;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Index past the first occurrence of `delimiter` at or after `index`, or `fallback` when there is none.
+ */
+static size_t skip_past(const charon_utf8_text_t *text, size_t index, const char *delimiter, size_t fallback) {
+    size_t length = strlen(delimiter);
+    for(; index + length <= text->size; index++) {
+        if(memcmp(&text->data[index], delimiter, length) == 0) return index + length;
+    }
+    return fallback;
+}
+
+/**
+ * Splits the text into chunks of at least `min_size` bytes, each but the first starting on a line that begins with a top level keyword at brace depth zero.
+ * A chunk starts after the first newline following the last token of the previous one, which is where the lexer ends the trailing trivia of that token.
+ * Strings, chars and comments are skipped like the lexer does so braces and keywords inside them are not counted.
+ * This is only a guess at item boundaries, `chunk_parse` checks that each chunk ends where the whole text would.
+ */
+static chunk_t *chunks_split(const charon_utf8_text_t *text, size_t min_size, size_t *chunk_count) {
+    chunk_t *chunks = nullptr;
+    size_t count = 0;
+
+    size_t start = 0, depth = 0;
+    // offset past the first newline after the last token, SIZE_MAX until a newline is seen
+    size_t line_start = SIZE_MAX;
+    for(size_t i = 0; i < text->size;) {
+        uint8_t ch = text->data[i];
+        uint8_t next = i + 1 < text->size ? text->data[i + 1] : '\0';
+
+        if(ch == '\n') {
+            if(line_start == SIZE_MAX) line_start = i + 1;
+            i++;
+            continue;
+        }
+        if(ch == ' ' || ch == '\t' || ch == '\r') {
+            i++;
+            continue;
+        }
+        if(ch == '#' || (ch == '/' && next == '/')) {
+            while(i < text->size && text->data[i] != '\n') i++;
+            continue;
+        }
+        if(ch == '/' && next == '*') {
+            i = skip_past(text, i + 2, "*/", i + 1);
+            continue;
+        }
+
+        if(line_start != SIZE_MAX && depth == 0 && line_start - start >= min_size && is_tlc_keyword(text, i)) {
+            chunks = reallocarray(chunks, count + 1, sizeof(chunk_t));
+            chunks[count++] = (chunk_t) { .start = start, .end = line_start };
+            start = line_start;
+        }
+        line_start = SIZE_MAX;
+
+        switch(ch) {
+            case '{': depth++; i++; break;
+            case '}':
+                if(depth > 0) depth--;
+                i++;
+                break;
+            case '"': {
+                size_t end = i + 1;
+                while(end < text->size && text->data[end] != '"' && text->data[end] != '\n') end++;
+                i = end < text->size && text->data[end] == '"' ? end + 1 : i + 1;
+                break;
+            }
+            case '\'': {
+                // raw strings take priority over chars, an unterminated raw string start is an empty char
+                if(next == '\'') {
+                    i = skip_past(text, i + 2, "''", i + 2);
+                } else {
+                    i = skip_past(text, i + 1, "'", i + 1);
+                }
+                break;
+            }
+            default: i++; break;
+        }
+    }
+
+    chunks = reallocarray(chunks, count + 1, sizeof(chunk_t));
+    chunks[count++] = (chunk_t) { .start = start, .end = text->size };
+
+    *chunk_count = count;
+    return chunks;
+}
+
+/**
+ * Parses the top level items of a chunk with its own lexer and parser. The last chunk is parsed as a root including the end of file token.
+ * Any other chunk is exact when no item looked at the end of file, the lexer did not examine the end of the chunk and no trivia was left for the end of file token.
+ */
+static void chunk_parse(charon_element_cache_t *cache, const charon_utf8_text_t *text, chunk_t *chunk, bool is_last) {
+    charon_utf8_text_t *chunk_text = charon_utf8_from((const char *) &text->data[chunk->start], chunk->end - chunk->start);
+    charon_lexer_t *lexer = charon_lexer_make(cache, chunk_text);
+    charon_parser_t *parser = charon_parser_make(cache, lexer);
+
+    if(is_last) {
+        chunk->output = charon_parser_parse_root(parser);
+        chunk->is_exact = true;
+    } else {
+        parser_open_element(parser);
+
+        bool is_eof_examined = false;
+        while(!parser_is_eof(parser)) {
+            parse_tlc(parser);
+            is_eof_examined = parser->is_eof_examined;
+        }
+
+        parser_close_element(parser, CHARON_NODE_KIND_ROOT);
+        chunk->output = parser_build(parser);
+        chunk->is_exact = !is_eof_examined && !charon_lexer_is_end_examined(lexer) && charon_element_length(charon_lexer_peek(lexer)) == 0;
+    }
+
+    charon_parser_destroy(parser);
+    charon_lexer_destroy(lexer);
+    free(chunk_text);
+}
+
+static void chunk_discard(chunk_t *chunk) {
+    charon_diag_item_t *next_diag = chunk->output.diagnostics;
+    while(next_diag != nullptr) {
+        charon_diag_item_t *diag = next_diag;
+        next_diag = diag->next;
+
+        charon_path_destroy(diag->path);
+        free(diag->data);
+        free(diag);
+    }
+}
+
+static void *chunk_worker(void *argument) {
+    chunk_queue_t *queue = argument;
+    while(true) {
+        size_t index = atomic_fetch_add(&queue->next_chunk, 1);
+        if(index >= queue->chunk_count) return nullptr;
+        chunk_parse(queue->cache, queue->text, &queue->chunks[index], index == queue->chunk_count - 1);
+    }
+}
+
+charon_parser_output_t charon_parser_parse_root_parallel(charon_element_cache_t *element_cache, const charon_utf8_text_t *text, size_t thread_count) {
+    assert(thread_count > 0);
+
+    size_t min_size = text->size / (thread_count * CHUNKS_PER_THREAD);
+    if(min_size < CHUNK_MIN_SIZE) min_size = CHUNK_MIN_SIZE;
+
+    chunk_queue_t queue = { .cache = element_cache, .text = text };
+    queue.chunks = chunks_split(text, min_size, &queue.chunk_count);
+    atomic_init(&queue.next_chunk, 0);
+
+    // the calling thread works the queue too
+    size_t worker_count = thread_count < queue.chunk_count ? thread_count : queue.chunk_count;
+    pthread_t *workers = malloc((worker_count - 1) * sizeof(pthread_t));
+    size_t started_count = 0;
+    for(; started_count < worker_count - 1; started_count++) {
+        if(pthread_create(&workers[started_count], nullptr, chunk_worker, &queue) != 0) break;
+    }
+    chunk_worker(&queue);
+    for(size_t i = 0; i < started_count; i++) pthread_join(workers[i], nullptr);
+    free(workers);
+
+    // a chunk that is not exact ended inside an item, it is merged with the next chunk and parsed again
+    chunk_t *chunks = queue.chunks;
+    size_t chunk_count = queue.chunk_count;
+    for(size_t i = 0; i < chunk_count;) {
+        if(chunks[i].is_exact) {
+            i++;
+            continue;
+        }
+
+        assert(i + 1 < chunk_count);
+        chunk_discard(&chunks[i]);
+        chunk_discard(&chunks[i + 1]);
+        chunks[i + 1].start = chunks[i].start;
+        memmove(&chunks[i], &chunks[i + 1], (chunk_count - i - 1) * sizeof(chunk_t));
+        chunk_count--;
+
+        chunk_parse(element_cache, text, &chunks[i], i == chunk_count - 1);
+    }
+
+    size_t child_count = 0;
+    for(size_t i = 0; i < chunk_count; i++) child_count += charon_element_node_child_count(chunks[i].output.root);
+
+    const charon_element_inner_t **children = malloc(child_count * sizeof(charon_element_inner_t *));
+    charon_diag_item_t *diagnostics = nullptr;
+    size_t child_offset = 0;
+    for(size_t i = 0; i < chunk_count; i++) {
+        const charon_element_inner_t *chunk_root = chunks[i].output.root;
+        size_t chunk_child_count = charon_element_node_child_count(chunk_root);
+        for(size_t j = 0; j < chunk_child_count; j++) children[child_offset + j] = charon_element_node_child(chunk_root, j);
+
+        // diagnostics are listed last first like a single parse lists them, so every chunk goes in front of the ones before it
+        charon_diag_item_t *chunk_diagnostics = chunks[i].output.diagnostics;
+        if(chunk_diagnostics != nullptr) {
+            charon_diag_item_t *last_diag = chunk_diagnostics;
+            for(charon_diag_item_t *diag = chunk_diagnostics; diag != nullptr; diag = diag->next) {
+                assert(diag->path->length > 0);
+                diag->path->steps[0] += child_offset;
+                last_diag = diag;
+            }
+            last_diag->next = diagnostics;
+            diagnostics = chunk_diagnostics;
+        }
+
+        child_offset += chunk_child_count;
+    }
+
+    const charon_element_inner_t *root = charon_element_inner_make_node(element_cache, CHARON_NODE_KIND_ROOT, children, child_count);
+    bool is_end_examined = chunks[chunk_count - 1].output.is_end_examined;
+
+    free(children);
+    free(chunks);
+
+    return (charon_parser_output_t) { .root = root, .diagnostics = diagnostics, .is_end_examined = is_end_examined };
+}
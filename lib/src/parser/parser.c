@@ -7,28 +7,39 @@
 #include "charon/parser.h"
 #include "charon/path.h"
 #include "charon/token.h"
-#include "common/list.h"
 #include "parser/parse.h"
 
 #include <assert.h>
-#include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 typedef enum {
     PARSER_EVENT_TYPE_OPEN,
     PARSER_EVENT_TYPE_CLOSE,
     PARSER_EVENT_TYPE_TOKEN,
+    PARSER_EVENT_TYPE_NODE,
     PARSER_EVENT_TYPE_ERROR
 } parser_event_type_t;
 
+#define EVENTS_INITIAL_CAPACITY 256
+#define BUILD_STACK_INITIAL_CAPACITY 64
+
 typedef struct parser_event {
     parser_event_type_t event_type;
+
+    // elements opened retroactively right before this event, see `parser_open_element_at`
+    uint32_t preceding_open_count;
+
     union {
         struct {
             const charon_element_inner_t *token;
         } token;
+        struct {
+            const charon_element_inner_t *node;
+        } node;
         struct {
             charon_node_kind_t kind;
         } close;
@@ -37,29 +48,39 @@ typedef struct parser_event {
             charon_diag_data_t *diag_data;
         } error;
     };
-
-    list_node_t list_node;
 } parser_event_t;
 
-typedef struct build_node {
-    struct build_node *parent;
+static void build_push_child(charon_parser_t *parser, const charon_element_inner_t *element) {
+    if(parser->build_child_count == parser->build_child_capacity) {
+        parser->build_child_capacity = parser->build_child_capacity == 0 ? BUILD_STACK_INITIAL_CAPACITY : parser->build_child_capacity * 2;
+        parser->build_children = reallocarray(parser->build_children, parser->build_child_capacity, sizeof(const charon_element_inner_t *));
+    }
+    parser->build_children[parser->build_child_count++] = element;
+}
 
-    size_t self_index;
+static void build_push_frame(charon_parser_t *parser) {
+    if(parser->build_frame_count == parser->build_frame_capacity) {
+        parser->build_frame_capacity = parser->build_frame_capacity == 0 ? BUILD_STACK_INITIAL_CAPACITY : parser->build_frame_capacity * 2;
+        parser->build_frames = reallocarray(parser->build_frames, parser->build_frame_capacity, sizeof(size_t));
+    }
+    parser->build_frames[parser->build_frame_count++] = parser->build_child_count;
+}
 
-    size_t element_count;
-    const charon_element_inner_t **elements;
-} build_node_t;
+static parser_event_t *push_event(charon_parser_t *parser, parser_event_type_t event_type) {
+    if(parser->event_count == parser->event_capacity) {
+        parser->event_capacity = parser->event_capacity == 0 ? EVENTS_INITIAL_CAPACITY : parser->event_capacity * 2;
+        parser->events = reallocarray(parser->events, parser->event_capacity, sizeof(parser_event_t));
+    }
 
-static void build_node_push(build_node_t *node, const charon_element_inner_t *element) {
-    node->elements = reallocarray(node->elements, ++node->element_count, sizeof(const charon_element_inner_t *));
-    node->elements[node->element_count - 1] = element;
+    parser_event_t *event = &parser->events[parser->event_count++];
+    event->event_type = event_type;
+    event->preceding_open_count = 0;
+    return event;
 }
 
 static void raw_consume(charon_parser_t *parser) {
-    parser_event_t *event = malloc(sizeof(parser_event_t));
-    event->event_type = PARSER_EVENT_TYPE_TOKEN;
+    parser_event_t *event = push_event(parser, PARSER_EVENT_TYPE_TOKEN);
     event->token.token = charon_lexer_advance(parser->lexer);
-    list_push(&parser->events, &event->list_node);
 }
 
 charon_parser_t *charon_parser_make(charon_element_cache_t *element_cache, charon_lexer_t *lexer) {
@@ -67,20 +88,42 @@ charon_parser_t *charon_parser_make(charon_element_cache_t *element_cache, charo
     parser->cache = element_cache;
     parser->lexer = lexer;
 
-    for(size_t i = 0; i < CHARON_TOKEN_KIND_COUNT; i++) parser->syncset.token_kinds[i] = false;
-    parser->events = LIST_INIT;
+    parser->syncset = PARSER_TOKEN_SET_EMPTY;
+    parser->is_eof_examined = false;
+    parser->event_count = 0;
+    parser->event_capacity = 0;
+    parser->events = nullptr;
+    parser->build_child_count = 0;
+    parser->build_child_capacity = 0;
+    parser->build_children = nullptr;
+    parser->build_frame_count = 0;
+    parser->build_frame_capacity = 0;
+    parser->build_frames = nullptr;
     return parser;
 }
 
 void charon_parser_destroy(charon_parser_t *parser) {
-    list_node_t *lnode;
-    while((lnode = list_pop(&parser->events)) != nullptr) {
-        free(LIST_CONTAINER_OF(lnode, parser_event_t, list_node));
-    }
-
+    free(parser->events);
+    free(parser->build_children);
+    free(parser->build_frames);
     free(parser);
 }
 
+charon_parser_output_t charon_parser_parse_type(charon_parser_t *parser) {
+    parse_type(parser);
+    return parser_build(parser);
+}
+
+charon_parser_output_t charon_parser_parse_type_function(charon_parser_t *parser) {
+    parse_type_function(parser);
+    return parser_build(parser);
+}
+
+charon_parser_output_t charon_parser_parse_expr(charon_parser_t *parser) {
+    parse_expr(parser);
+    return parser_build(parser);
+}
+
 charon_parser_output_t charon_parser_parse_stmt(charon_parser_t *parser) {
     parse_stmt(parser);
     return parser_build(parser);
@@ -91,123 +134,163 @@ charon_parser_output_t charon_parser_parse_stmt_block(charon_parser_t *parser) {
     return parser_build(parser);
 }
 
+charon_parser_output_t charon_parser_parse_tlc(charon_parser_t *parser) {
+    parse_tlc(parser);
+    return parser_build(parser);
+}
+
 charon_parser_output_t charon_parser_parse_root(charon_parser_t *parser) {
     parse_root(parser);
     return parser_build(parser);
 }
 
+charon_parser_reparse_fn_t charon_parser_reparse_fn(charon_node_kind_t kind) {
+    static const charon_parser_reparse_fn_t reparse_fns[] = {
+        [CHARON_NODE_KIND_ROOT] = charon_parser_parse_root,
+
+        [CHARON_NODE_KIND_TYPE_REFERENCE] = charon_parser_parse_type,
+        [CHARON_NODE_KIND_TYPE_STRUCT] = charon_parser_parse_type,
+        [CHARON_NODE_KIND_TYPE_TUPLE] = charon_parser_parse_type,
+        [CHARON_NODE_KIND_TYPE_ARRAY] = charon_parser_parse_type,
+        [CHARON_NODE_KIND_TYPE_POINTER] = charon_parser_parse_type,
+        [CHARON_NODE_KIND_TYPE_FUNCTION] = charon_parser_parse_type_function,
+        [CHARON_NODE_KIND_TYPE_FUNCTION_REF] = charon_parser_parse_type,
+
+        [CHARON_NODE_KIND_TLC_MODULE] = charon_parser_parse_tlc,
+        [CHARON_NODE_KIND_TLC_FUNCTION] = charon_parser_parse_tlc,
+        [CHARON_NODE_KIND_TLC_EXTERN] = charon_parser_parse_tlc,
+        [CHARON_NODE_KIND_TLC_DECLARATION] = charon_parser_parse_tlc,
+        [CHARON_NODE_KIND_TLC_TYPE_DEFINITION] = charon_parser_parse_tlc,
+        [CHARON_NODE_KIND_TLC_ENUMERATION] = charon_parser_parse_tlc,
+
+        [CHARON_NODE_KIND_STMT] = charon_parser_parse_stmt,
+        [CHARON_NODE_KIND_STMT_BLOCK] = charon_parser_parse_stmt_block,
+
+        [CHARON_NODE_KIND_EXPR_LITERAL_NUMERIC] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_LITERAL_STRING] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_LITERAL_CHAR] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_LITERAL_BOOL] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_LITERAL_STRUCT] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_BINARY] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_UNARY] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_VARIABLE] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_CALL] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_TUPLE] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_CAST] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_SUBSCRIPT] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_SUBSCRIPT_DEREF] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_SELECTOR] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_SIZEOF] = charon_parser_parse_expr,
+        [CHARON_NODE_KIND_EXPR_PARENTHESES] = charon_parser_parse_expr,
+    };
+    if(kind >= sizeof(reparse_fns) / sizeof(reparse_fns[0])) return nullptr;
+    return reparse_fns[kind];
+}
+
 bool parser_is_eof(charon_parser_t *parser) {
-    return charon_lexer_is_eof(parser->lexer);
+    if(!charon_lexer_is_eof(parser->lexer)) return false;
+    parser->is_eof_examined = true;
+    return true;
 }
 
 charon_token_kind_t parser_peek(charon_parser_t *parser) {
-    return charon_element_token_kind(charon_lexer_peek(parser->lexer));
+    charon_token_kind_t kind = charon_element_token_kind(charon_lexer_peek(parser->lexer));
+    if(kind == CHARON_TOKEN_KIND_EOF) parser->is_eof_examined = true;
+    return kind;
 }
 
-void parser_consume(charon_parser_t *parser, charon_token_kind_t kind) {
-    parser_consume_many(parser, 1, kind);
+bool parser_token_set_has(parser_token_set_t set, charon_token_kind_t kind) {
+    return (set & PARSER_TOKEN_SET(kind)) != 0;
 }
 
-void parser_consume_many(charon_parser_t *parser, size_t count, ...) {
-    va_list list;
-    va_start(list, count);
-    bool result = parser_consume_try_many_list(parser, count, list);
-    va_end(list);
-    if(result) return;
-
-    charon_diag_data_t *diag_data = malloc(sizeof(charon_diag_data_t) + count * sizeof(charon_token_kind_t));
-    diag_data->unexpected_token.found = parser_peek(parser);
-    diag_data->unexpected_token.expected_count = count;
+bool parser_at_set(charon_parser_t *parser, parser_token_set_t set) {
+    return parser_token_set_has(set, parser_peek(parser));
+}
 
-    va_start(list, count);
-    for(size_t i = 0; i < count; i++) diag_data->unexpected_token.expected[i] = va_arg(list, charon_token_kind_t);
-    va_end(list);
+void parser_consume(charon_parser_t *parser, charon_token_kind_t kind) {
+    parser_consume_list(parser, &(parser_token_list_t) { .set = PARSER_TOKEN_SET(kind), .count = 1, .kinds = &kind });
+}
 
-    parser_error(parser, CHARON_DIAG_UNEXPECTED_TOKEN, diag_data);
+void parser_consume_list(charon_parser_t *parser, const parser_token_list_t *list) {
+    if(parser_consume_try_set(parser, list->set)) return;
+    parser_error_expected(parser, list);
 }
 
 bool parser_consume_try(charon_parser_t *parser, charon_token_kind_t kind) {
-    return parser_consume_try_many(parser, 1, kind);
+    return parser_consume_try_set(parser, PARSER_TOKEN_SET(kind));
 }
 
-bool parser_consume_try_many(charon_parser_t *parser, size_t count, ...) {
-    va_list list;
-    va_start(list, count);
-    bool result = parser_consume_try_many_list(parser, count, list);
-    va_end(list);
-    return result;
+bool parser_consume_try_set(charon_parser_t *parser, parser_token_set_t set) {
+    if(!parser_at_set(parser, set)) return false;
+    raw_consume(parser);
+    return true;
 }
 
-bool parser_consume_try_many_list(charon_parser_t *parser, size_t count, va_list list) {
-    charon_token_kind_t kind = parser_peek(parser);
-    for(size_t i = 0; i < count; i++) {
-        charon_token_kind_t valid_kind = va_arg(list, charon_token_kind_t);
-        if(kind != valid_kind) continue;
+bool parser_reuse_node(charon_parser_t *parser, charon_node_kind_t kind) {
+    const charon_element_inner_t *node = charon_lexer_reuse_node(parser->lexer, kind);
+    if(node == nullptr) return false;
 
-        raw_consume(parser);
-        return true;
-    }
-    return false;
+    parser_event_t *event = push_event(parser, PARSER_EVENT_TYPE_NODE);
+    event->node.node = node;
+    return true;
 }
 
-parser_event_t *parser_checkpoint(charon_parser_t *parser) {
-    return LIST_CONTAINER_OF(parser->events.head, parser_event_t, list_node);
+parser_checkpoint_t parser_checkpoint(charon_parser_t *parser) {
+    return parser->event_count;
 }
 
-void parser_open_element_at(charon_parser_t *parser, parser_event_t *checkpoint) {
-    parser_event_t *event = malloc(sizeof(parser_event_t));
-    event->event_type = PARSER_EVENT_TYPE_OPEN;
-    list_node_prepend(&parser->events, &checkpoint->list_node, &event->list_node);
+void parser_open_element_at(charon_parser_t *parser, parser_checkpoint_t checkpoint) {
+    assert(checkpoint <= parser->event_count);
+    if(checkpoint == parser->event_count) return parser_open_element(parser);
+
+    // open events carry no data, so opening in front of an existing event is just counted on that event
+    parser->events[checkpoint].preceding_open_count++;
 }
 
 void parser_open_element(charon_parser_t *parser) {
-    parser_event_t *event = malloc(sizeof(parser_event_t));
-    event->event_type = PARSER_EVENT_TYPE_OPEN;
-    list_push(&parser->events, &event->list_node);
+    push_event(parser, PARSER_EVENT_TYPE_OPEN);
 }
 
 void parser_close_element(charon_parser_t *parser, charon_node_kind_t kind) {
-    parser_event_t *event = malloc(sizeof(parser_event_t));
-    event->event_type = PARSER_EVENT_TYPE_CLOSE;
+    parser_event_t *event = push_event(parser, PARSER_EVENT_TYPE_CLOSE);
     event->close.kind = kind;
-    list_push(&parser->events, &event->list_node);
 }
 
 void parser_error(charon_parser_t *parser, charon_diag_t diag, charon_diag_data_t *diag_data) {
     parser_open_element(parser);
-    if(!parser->syncset.token_kinds[parser_peek(parser)]) raw_consume(parser);
+    if(!parser_at_set(parser, parser->syncset)) raw_consume(parser);
 
-    parser_event_t *event = malloc(sizeof(parser_event_t));
-    event->event_type = PARSER_EVENT_TYPE_ERROR;
+    parser_event_t *event = push_event(parser, PARSER_EVENT_TYPE_ERROR);
     event->error.diag = diag;
     event->error.diag_data = diag_data;
-    list_push(&parser->events, &event->list_node);
 }
 
-charon_parser_output_t parser_build(charon_parser_t *parser) {
-    size_t depth = 0;
-    build_node_t *open_node = nullptr;
+void parser_error_expected(charon_parser_t *parser, const parser_token_list_t *expected) {
+    charon_diag_data_t *diag_data = malloc(sizeof(charon_diag_data_t) + expected->count * sizeof(charon_token_kind_t));
+    diag_data->unexpected_token.found = parser_peek(parser);
+    diag_data->unexpected_token.expected_count = expected->count;
+    memcpy(&diag_data->unexpected_token.expected, expected->kinds, expected->count * sizeof(charon_token_kind_t));
 
+    parser_error(parser, CHARON_DIAG_UNEXPECTED_TOKEN, diag_data);
+}
+
+charon_parser_output_t parser_build(charon_parser_t *parser) {
     charon_diag_item_t *diagnostics = nullptr;
 
-    list_node_t *lnode;
-    while((lnode = list_pop_back(&parser->events)) != nullptr) {
-        parser_event_t *event = LIST_CONTAINER_OF(lnode, parser_event_t, list_node);
+    for(size_t i = 0; i < parser->event_count; i++) {
+        parser_event_t *event = &parser->events[i];
+
+        for(size_t j = 0; j < event->preceding_open_count + (event->event_type == PARSER_EVENT_TYPE_OPEN ? 1 : 0); j++) build_push_frame(parser);
 
         charon_node_kind_t build_kind;
         switch(event->event_type) {
-            case PARSER_EVENT_TYPE_OPEN: {
-                build_node_t *new_node = malloc(sizeof(build_node_t));
-                new_node->parent = open_node;
-                new_node->self_index = open_node == nullptr ? 0 : open_node->element_count;
-                new_node->elements = nullptr;
-                new_node->element_count = 0;
-                open_node = new_node;
-                depth++;
+            case PARSER_EVENT_TYPE_OPEN: break;
+            case PARSER_EVENT_TYPE_TOKEN: {
+                build_push_child(parser, event->token.token);
                 break;
             }
-            case PARSER_EVENT_TYPE_TOKEN: {
-                build_node_push(open_node, event->token.token);
+            case PARSER_EVENT_TYPE_NODE: {
+                build_push_child(parser, event->node.node);
                 break;
             }
             case PARSER_EVENT_TYPE_CLOSE: {
@@ -215,15 +298,10 @@ charon_parser_output_t parser_build(charon_parser_t *parser) {
                 goto build_node;
             }
             case PARSER_EVENT_TYPE_ERROR: {
+                // the index of an open element within its parent is where its children start relative to the parent's
+                size_t depth = parser->build_frame_count;
                 charon_path_t *path = charon_path_make(depth - 1);
-                build_node_t *current_node = open_node;
-
-                size_t index = depth - 1;
-                while(current_node->parent != nullptr) {
-                    assert(index > 0);
-                    path->steps[--index] = current_node->self_index;
-                    current_node = current_node->parent;
-                }
+                for(size_t j = 1; j < depth; j++) path->steps[j - 1] = parser->build_frames[j] - parser->build_frames[j - 1];
 
                 charon_diag_item_t *diag_item = malloc(sizeof(charon_diag_item_t));
                 diag_item->kind = event->error.diag;
@@ -238,25 +316,22 @@ charon_parser_output_t parser_build(charon_parser_t *parser) {
             }
 
             build_node: {
-                build_node_t *current = open_node;
-                assert(current != nullptr);
+                assert(parser->build_frame_count > 0);
 
-                build_node_t *parent = open_node->parent;
-                open_node = parent;
+                size_t start = parser->build_frames[--parser->build_frame_count];
+                const charon_element_inner_t *element = charon_element_inner_make_node(parser->cache, build_kind, &parser->build_children[start], parser->build_child_count - start);
+                parser->build_child_count = start;
 
-                const charon_element_inner_t *element = charon_element_inner_make_node(parser->cache, build_kind, current->elements, current->element_count);
-                free(current->elements);
-                free(current);
-
-                if(parent == nullptr) return (charon_parser_output_t) { .root = element, .diagnostics = diagnostics };
+                if(parser->build_frame_count == 0) {
+                    parser->event_count = 0;
+                    bool is_end_examined = parser->is_eof_examined || charon_lexer_is_end_examined(parser->lexer);
+                    return (charon_parser_output_t) { .root = element, .diagnostics = diagnostics, .is_end_examined = is_end_examined };
+                }
 
-                build_node_push(parent, element);
-                depth--;
+                build_push_child(parser, element);
                 break;
             }
         }
-
-        free(event);
     }
     assert(false);
 }
@@ -5,39 +5,93 @@
 #include "charon/node.h"
 #include "charon/parser.h"
 #include "charon/token.h"
-#include "common/list.h"
 
-#include <stdarg.h>
+#include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 
-typedef struct parser_event parser_event_t;
+/**
+ * Set of token kinds as a bitmask, constant sets are built by combining `PARSER_TOKEN_SET` with `|`.
+ */
+typedef unsigned __int128 parser_token_set_t;
+
+static_assert(CHARON_TOKEN_KIND_COUNT <= 128, "token kinds must fit in a token set");
 
+#define PARSER_TOKEN_SET_EMPTY ((parser_token_set_t) 0)
+#define PARSER_TOKEN_SET(KIND) (((parser_token_set_t) 1) << (KIND))
+
+/**
+ * Token kinds a diagnostic lists in order when none of them is found, along with their set.
+ * Constant lists are built with `PARSER_TOKEN_LIST` from an X-macro `LIST(X)` that calls `X` with each token kind name.
+ */
 typedef struct {
-    bool token_kinds[CHARON_TOKEN_KIND_COUNT];
-} parser_syncset_t;
+    parser_token_set_t set;
+    size_t count;
+    const charon_token_kind_t *kinds;
+} parser_token_list_t;
+
+#define PARSER_TOKEN_LIST_SET(KIND) | PARSER_TOKEN_SET(CHARON_TOKEN_KIND_##KIND)
+#define PARSER_TOKEN_LIST_KIND(KIND) CHARON_TOKEN_KIND_##KIND,
+#define PARSER_TOKEN_LIST(LIST)                                                                                                     \
+    {                                                                                                                               \
+        .set = PARSER_TOKEN_SET_EMPTY LIST(PARSER_TOKEN_LIST_SET),                                                                  \
+        .count = sizeof((const charon_token_kind_t[]) { LIST(PARSER_TOKEN_LIST_KIND) }) / sizeof(charon_token_kind_t),              \
+        .kinds = (const charon_token_kind_t[]) { LIST(PARSER_TOKEN_LIST_KIND) }                                                      \
+    }
+
+typedef struct parser_event parser_event_t;
+
+/**
+ * Index into the event buffer, elements can be opened retroactively in front of the event at this index.
+ */
+typedef size_t parser_checkpoint_t;
 
 struct charon_parser {
     charon_element_cache_t *cache;
     charon_lexer_t *lexer;
 
-    parser_syncset_t syncset;
-    list_t events;
+    parser_token_set_t syncset;
+
+    // set once the parser looked at the end of file token, see `charon_parser_output_t`
+    bool is_eof_examined;
+
+    size_t event_count, event_capacity;
+    parser_event_t *events;
+
+    // shared stacks of `parser_build`, every open element is a frame holding where its children start on the child stack
+    size_t build_child_count, build_child_capacity;
+    const charon_element_inner_t **build_children;
+    size_t build_frame_count, build_frame_capacity;
+    size_t *build_frames;
 };
 
 bool parser_is_eof(charon_parser_t *parser);
 charon_token_kind_t parser_peek(charon_parser_t *parser);
 
+bool parser_token_set_has(parser_token_set_t set, charon_token_kind_t kind);
+bool parser_at_set(charon_parser_t *parser, parser_token_set_t set);
+
 void parser_consume(charon_parser_t *parser, charon_token_kind_t kind);
-void parser_consume_many(charon_parser_t *parser, size_t count, ...);
+void parser_consume_list(charon_parser_t *parser, const parser_token_list_t *list);
 
 bool parser_consume_try(charon_parser_t *parser, charon_token_kind_t kind);
-bool parser_consume_try_many(charon_parser_t *parser, size_t count, ...);
-bool parser_consume_try_many_list(charon_parser_t *parser, size_t count, va_list list);
+bool parser_consume_try_set(charon_parser_t *parser, parser_token_set_t set);
+
+/**
+ * Take an unchanged node of `kind` from the previous tree as a whole instead of parsing it, see `charon_lexer_reuse_node`.
+ * Returns false when no node can be reused at the current token.
+ */
+bool parser_reuse_node(charon_parser_t *parser, charon_node_kind_t kind);
 
-parser_event_t *parser_checkpoint(charon_parser_t *parser);
-void parser_open_element_at(charon_parser_t *parser, parser_event_t *checkpoint);
+parser_checkpoint_t parser_checkpoint(charon_parser_t *parser);
+void parser_open_element_at(charon_parser_t *parser, parser_checkpoint_t checkpoint);
 void parser_open_element(charon_parser_t *parser);
 void parser_close_element(charon_parser_t *parser, charon_node_kind_t kind);
 void parser_error(charon_parser_t *parser, charon_diag_t diag_kind, charon_diag_data_t *diag_kind_data);
 
+/**
+ * Report an unexpected token diagnostic listing the expected kinds in order.
+ */
+void parser_error_expected(charon_parser_t *parser, const parser_token_list_t *expected);
+
 charon_parser_output_t parser_build(charon_parser_t *parser);
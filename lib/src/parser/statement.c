@@ -5,8 +5,8 @@
 #include "parser/parser.h"
 
 static void parse_expression(charon_parser_t *parser) {
-    parser_syncset_t prev_syncset = parser->syncset;
-    parser->syncset.token_kinds[CHARON_TOKEN_KIND_PNCT_SEMI_COLON] = true;
+    parser_token_set_t prev_syncset = parser->syncset;
+    parser->syncset |= PARSER_TOKEN_SET(CHARON_TOKEN_KIND_PNCT_SEMI_COLON);
 
     parser_open_element(parser);
 
@@ -96,7 +96,7 @@ static void parse_switch(charon_parser_t *parser) {
     parse_expr(parser);
     parser_consume(parser, CHARON_TOKEN_KIND_PNCT_PARENTHESES_RIGHT);
     parser_consume(parser, CHARON_TOKEN_KIND_PNCT_BRACE_LEFT);
-    while(!parser_consume_try(parser, CHARON_TOKEN_KIND_PNCT_BRACE_RIGHT)) {
+    while(!parser_is_eof(parser) && !parser_consume_try(parser, CHARON_TOKEN_KIND_PNCT_BRACE_RIGHT)) {
         if(parser_consume_try(parser, CHARON_TOKEN_KIND_KEYWORD_DEFAULT)) {
             parser_consume(parser, CHARON_TOKEN_KIND_PNCT_THICK_ARROW);
             parse_stmt(parser);
@@ -112,8 +112,8 @@ static void parse_switch(charon_parser_t *parser) {
 }
 
 void parse_stmt_block(charon_parser_t *parser) {
-    parser_syncset_t prev_syncset = parser->syncset;
-    parser->syncset.token_kinds[CHARON_TOKEN_KIND_PNCT_BRACE_RIGHT] = true;
+    parser_token_set_t prev_syncset = parser->syncset;
+    parser->syncset |= PARSER_TOKEN_SET(CHARON_TOKEN_KIND_PNCT_BRACE_RIGHT);
 
     parser_open_element(parser);
 
@@ -146,6 +146,8 @@ static void parse_break(charon_parser_t *parser) {
 }
 
 void parse_stmt(charon_parser_t *parser) {
+    if(parser_reuse_node(parser, CHARON_NODE_KIND_STMT)) return;
+
     parser_open_element(parser);
 
     switch(parser_peek(parser)) {
@@ -4,9 +4,13 @@
 #include "parse.h"
 #include "parser/parser.h"
 
-#include <string.h>
+#define TLC_START(X) X(KEYWORD_MODULE) X(KEYWORD_FUNCTION) X(KEYWORD_EXTERN) X(KEYWORD_TYPE) X(KEYWORD_LET) X(KEYWORD_ENUM)
+
+static const parser_token_list_t g_tlc_start = PARSER_TOKEN_LIST(TLC_START);
 
 static void parse_type_definition(charon_parser_t *parser) {
+    if(parser_reuse_node(parser, CHARON_NODE_KIND_TLC_TYPE_DEFINITION)) return;
+
     parser_open_element(parser);
 
     parser_consume(parser, CHARON_TOKEN_KIND_KEYWORD_TYPE);
@@ -23,6 +27,8 @@ static void parse_type_definition(charon_parser_t *parser) {
 }
 
 static void parse_module(charon_parser_t *parser) {
+    if(parser_reuse_node(parser, CHARON_NODE_KIND_TLC_MODULE)) return;
+
     parser_open_element(parser);
 
     parser_consume(parser, CHARON_TOKEN_KIND_KEYWORD_MODULE);
@@ -36,6 +42,8 @@ static void parse_module(charon_parser_t *parser) {
 }
 
 static void parse_function(charon_parser_t *parser) {
+    if(parser_reuse_node(parser, CHARON_NODE_KIND_TLC_FUNCTION)) return;
+
     parser_open_element(parser);
 
     parser_consume(parser, CHARON_TOKEN_KIND_KEYWORD_FUNCTION);
@@ -53,6 +61,8 @@ static void parse_function(charon_parser_t *parser) {
 }
 
 static void parse_extern(charon_parser_t *parser) {
+    if(parser_reuse_node(parser, CHARON_NODE_KIND_TLC_EXTERN)) return;
+
     parser_open_element(parser);
 
     parser_consume(parser, CHARON_TOKEN_KIND_KEYWORD_EXTERN);
@@ -65,6 +75,8 @@ static void parse_extern(charon_parser_t *parser) {
 }
 
 static void parse_declaration(charon_parser_t *parser) {
+    if(parser_reuse_node(parser, CHARON_NODE_KIND_TLC_DECLARATION)) return;
+
     parser_open_element(parser);
 
     parser_consume(parser, CHARON_TOKEN_KIND_KEYWORD_LET);
@@ -78,6 +90,8 @@ static void parse_declaration(charon_parser_t *parser) {
 }
 
 static void parse_enum(charon_parser_t *parser) {
+    if(parser_reuse_node(parser, CHARON_NODE_KIND_TLC_ENUMERATION)) return;
+
     parser_open_element(parser);
 
     parser_consume(parser, CHARON_TOKEN_KIND_KEYWORD_ENUM);
@@ -101,16 +115,6 @@ void parse_tlc(charon_parser_t *parser) {
         case CHARON_TOKEN_KIND_KEYWORD_TYPE:     parse_type_definition(parser); break;
         case CHARON_TOKEN_KIND_KEYWORD_LET:      parse_declaration(parser); break;
         case CHARON_TOKEN_KIND_KEYWORD_ENUM:     parse_enum(parser); break;
-        default:                                 {
-            charon_token_kind_t kinds[6] = { CHARON_TOKEN_KIND_KEYWORD_MODULE, CHARON_TOKEN_KIND_KEYWORD_FUNCTION, CHARON_TOKEN_KIND_KEYWORD_EXTERN, CHARON_TOKEN_KIND_KEYWORD_TYPE, CHARON_TOKEN_KIND_KEYWORD_LET, CHARON_TOKEN_KIND_KEYWORD_ENUM };
-
-            charon_diag_data_t *diag_data = malloc(sizeof(charon_diag_data_t) + sizeof(kinds));
-            diag_data->unexpected_token.found = parser_peek(parser);
-            diag_data->unexpected_token.expected_count = sizeof(kinds) / sizeof(kinds[0]);
-            memcpy(&diag_data->unexpected_token.expected, kinds, sizeof(kinds));
-
-            parser_error(parser, CHARON_DIAG_UNEXPECTED_TOKEN, diag_data);
-            break;
-        }
+        default:                                 parser_error_expected(parser, &g_tlc_start); break;
     }
 }
@@ -18,17 +18,10 @@ const charon_element_inner_t *charon_util_element_swap_child(charon_element_cach
 }
 
 const charon_element_inner_t *charon_util_element_swap(charon_element_cache_t *cache, charon_element_t *old_subtree, const charon_element_inner_t *new_subtree) {
-    charon_element_t *current = old_subtree;
-    while(current->parent != nullptr) {
-        charon_element_t *parent = current->parent;
-        for(size_t i = 0; i < charon_element_node_child_count(parent->inner); i++) {
-            const charon_element_inner_t *child = charon_element_node_child(parent->inner, i);
-            if(child != current->inner) continue;
-
-            new_subtree = charon_util_element_swap_child(cache, parent->inner, i, new_subtree);
-            current = parent;
-            break;
-        }
+    // interned siblings can be the same inner element, so the child is located by its index rather than by identity
+    for(charon_element_t *current = old_subtree; current->parent != nullptr; current = current->parent) {
+        assert(charon_element_node_child(current->parent->inner, current->self_index) == current->inner);
+        new_subtree = charon_util_element_swap_child(cache, current->parent->inner, current->self_index, new_subtree);
     }
 
     return new_subtree;
@@ -1,7 +1,5 @@
 #include "document.h"
 
-#include "linedb.h"
-
 #include <charon/element.h>
 #include <charon/memory.h>
 #include <stddef.h>
@@ -22,9 +20,11 @@ document_t *document_get(const char *uri) {
     document_t *new_file = malloc(sizeof(document_t));
     new_file->uri = strdup(uri);
     new_file->allocator = charon_memory_allocator_make();
+    new_file->scratch_allocator = charon_memory_allocator_make();
     new_file->cache = charon_element_cache_make(new_file->allocator);
+    new_file->cache_live_size = 0;
     new_file->root_element = nullptr;
-    new_file->linedb = (linedb_t) { .line_count = 0, .line_starts = nullptr };
+    rope_init(&new_file->text, "", 0);
 
     g_source_files = reallocarray(g_source_files, ++g_source_file_count, sizeof(document_t *));
     g_source_files[g_source_file_count - 1] = new_file;
@@ -41,9 +41,10 @@ void document_free(document_t *file) {
         break;
     }
 
-    linedb_clear(&file->linedb);
+    rope_free(&file->text);
     charon_element_cache_destroy(file->cache);
     charon_memory_allocator_free(file->allocator);
+    charon_memory_allocator_free(file->scratch_allocator);
 
     free(file->uri);
     free(file);
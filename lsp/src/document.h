@@ -1,6 +1,6 @@
 #pragma once
 
-#include "linedb.h"
+#include "rope.h"
 
 #include <charon/diag.h>
 #include <charon/element.h>
@@ -11,12 +11,13 @@ typedef struct {
     char *uri;
 
     charon_memory_allocator_t *allocator;
+    charon_memory_allocator_t *scratch_allocator;
     charon_element_cache_t *cache;
+    // size of the cache right after its last collection, see `charon_element_cache_collect`
+    size_t cache_live_size;
 
-    size_t text_size;
-    char *text;
+    rope_t text;
 
-    linedb_t linedb;
     const charon_element_inner_t *root_element;
     charon_diag_item_t *diagnostics;
 } document_t;
@@ -5,6 +5,10 @@
 #include <json.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+
+extern const lsp_message_handler_t __start_lsp_handlers[];
+extern const lsp_message_handler_t __stop_lsp_handlers[];
 
 bool g_lsp_exit_code = 1;
 bool g_lsp_running = true;
@@ -25,3 +29,22 @@ void lsp_log(const char *fmt, ...) {
 
     va_end(list);
 }
+
+void lsp_dispatch(struct json_object *message) {
+    struct json_object *message_method;
+    json_object_object_get_ex(message, "method", &message_method);
+    json_object_is_type(message_method, json_type_string);
+    const char *method = json_object_get_string(message_method);
+
+    for(const lsp_message_handler_t *handler = __start_lsp_handlers; handler < __stop_lsp_handlers; ++handler) {
+        if(strcmp(handler->method, method) != 0) continue;
+        handler->handler(message);
+        return;
+    }
+
+    if(json_object_object_get_ex(message, "id", NULL)) {
+        struct json_object *id = NULL;
+        json_object_object_get_ex(message, "id", &id);
+        io_write_message_response_error(stdout, id, -32601, "Method not found");
+    }
+}
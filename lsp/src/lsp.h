@@ -13,3 +13,8 @@ extern bool g_lsp_exit_code;
 extern bool g_lsp_running;
 
 void lsp_log(const char *fmt, ...);
+
+/**
+ * Pass a message to the handler registered for its method, requests without one get a method not found error.
+ */
+void lsp_dispatch(struct json_object *message);
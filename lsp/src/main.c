@@ -1,13 +1,19 @@
 #include "io.h"
 #include "lsp.h"
+#include "replay.h"
 
 #include <json.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-extern const lsp_message_handler_t __start_lsp_handlers[];
-extern const lsp_message_handler_t __stop_lsp_handlers[];
-
 int main(int argc, char **argv) {
+    if(argc >= 3 && strcmp(argv[1], "--replay") == 0) {
+        // The notifications of the handlers are of no interest to a replay, it reports on stderr
+        if(freopen("/dev/null", "w", stdout) == nullptr) return EXIT_FAILURE;
+        return replay_run(argv[2], argc >= 4 ? argv[3] : nullptr) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     setvbuf(stdin, NULL, _IONBF, 0);
     setvbuf(stdout, NULL, _IONBF, 0);
 
@@ -18,24 +24,7 @@ int main(int argc, char **argv) {
             continue;
         }
 
-        struct json_object *message_method;
-        json_object_object_get_ex(message, "method", &message_method);
-        json_object_is_type(message_method, json_type_string);
-        const char *method = json_object_get_string(message_method);
-
-        for(const lsp_message_handler_t *handler = __start_lsp_handlers; handler < __stop_lsp_handlers; ++handler) {
-            if(strcmp(handler->method, method) != 0) continue;
-            handler->handler(message);
-            goto next;
-        }
-
-        if(json_object_object_get_ex(message, "id", NULL)) {
-            struct json_object *id = NULL;
-            json_object_object_get_ex(message, "id", &id);
-            io_write_message_response_error(stdout, id, -32601, "Method not found");
-        }
-
-    next:
+        lsp_dispatch(message);
         json_object_put(message);
     }
 
@@ -5,7 +5,6 @@
 #include "charon/util.h"
 #include "document.h"
 #include "io.h"
-#include "linedb.h"
 #include "lsp.h"
 #include "stdlib.h"
 
@@ -19,135 +18,216 @@
 #include <stddef.h>
 #include <string.h>
 
-[[maybe_unused]] static void print_tree(charon_memory_allocator_t *allocator, charon_element_t *element, int depth) {
-    switch(charon_element_type(element->inner)) {
+[[maybe_unused]] static void print_tree(charon_cursor_t *cursor, int depth) {
+    const charon_element_inner_t *element = charon_cursor_element(cursor);
+    switch(charon_element_type(element)) {
         case CHARON_ELEMENT_TYPE_TRIVIA: assert(false);
         case CHARON_ELEMENT_TYPE_NODE:   {
-            charon_node_kind_t node_kind = charon_element_node_kind(element->inner);
+            charon_node_kind_t node_kind = charon_element_node_kind(element);
             lsp_log("%*s%s", depth * 2, "", charon_node_kind_tostring(node_kind));
 
-            size_t child_count = charon_element_node_child_count(element->inner);
-            for(size_t i = 0; i < child_count; i++) {
-                charon_element_t *child = charon_element_wrap_node_child(allocator, element, i);
-                print_tree(allocator, child, depth + 1);
-            }
+            if(!charon_cursor_goto_first_child(cursor)) break;
+            do {
+                print_tree(cursor, depth + 1);
+            } while(charon_cursor_goto_next_sibling(cursor));
+            charon_cursor_goto_parent(cursor);
             break;
         }
         case CHARON_ELEMENT_TYPE_TOKEN:
-            charon_token_kind_t token_kind = charon_element_token_kind(element->inner);
-            lsp_log("%*s%s `%s`", depth * 2, "", charon_token_kind_tostring(token_kind), charon_element_token_text(element->inner));
+            charon_token_kind_t token_kind = charon_element_token_kind(element);
+            lsp_log("%*s%s `%s`", depth * 2, "", charon_token_kind_tostring(token_kind), charon_element_token_text(element));
             break;
     }
 }
 
-static size_t document_position_to_offset(document_t *document, size_t line, size_t column) {
-    size_t offset;
-    bool ok = linedb_line_to_offset(&document->linedb, line, &offset);
-    assert(ok);
-
-    for(size_t i = 0; i < column; i++) {
-        assert(offset < document->text_size);
-        char chr = document->text[offset];
-        assert(chr != '\n' && chr != '\0');
-        size_t chr_width = charon_utf8_lead_width(chr);
-        offset += chr_width;
-        if(chr_width == 4) column--;
+// Move the cursor down to the token whose text or trivia contains the offset.
+static void find_element(charon_cursor_t *cursor, size_t offset) {
+    while(charon_element_type(charon_cursor_element(cursor)) == CHARON_ELEMENT_TYPE_NODE) {
+        if(!charon_cursor_goto_child_containing_offset(cursor, offset)) break;
     }
-    return offset;
+
+    assert(charon_element_type(charon_cursor_element(cursor)) == CHARON_ELEMENT_TYPE_TOKEN);
 }
 
-static void document_offset_to_position(document_t *document, size_t offset, size_t *out_line, size_t *out_column) {
-    size_t line_offset = offset;
-    bool ok = linedb_offset_to_line(&document->linedb, &line_offset, out_line);
-    assert(ok);
-
-    size_t column = 0;
-    for(size_t i = line_offset; i < offset;) {
-        char chr = document->text[offset];
-        assert(chr != '\n' && chr != '\0');
-        size_t chr_width = charon_utf8_lead_width(chr);
-        i += chr_width;
-        column += (chr_width == 4) ? 2 : 1;
-    }
-    *out_column = column;
+// Move the cursor to the child that contains a given range, the cursor stays put when there is none.
+// - range_start is inclusive
+// - range_end is exclusive
+static bool find_range(charon_cursor_t *cursor, size_t range_start, size_t range_end) {
+    assert(charon_element_type(charon_cursor_element(cursor)) == CHARON_ELEMENT_TYPE_NODE);
+
+    if(!charon_cursor_goto_child_containing_offset(cursor, range_start)) return false;
+    if(range_end <= charon_cursor_offset(cursor) + charon_element_length(charon_cursor_element(cursor))) return true;
+
+    charon_cursor_goto_parent(cursor);
+    return false;
 }
 
-static charon_element_t *find_element(charon_memory_allocator_t *allocator, charon_element_t *current, size_t offset) {
-    if(charon_element_type(current->inner) == CHARON_ELEMENT_TYPE_NODE) {
-        for(size_t i = 0; i < charon_element_node_child_count(current->inner); i++) {
-            charon_element_t *child = charon_element_wrap_node_child(allocator, current, i);
-            if(offset >= child->offset && offset < child->offset + charon_element_length(child->inner)) return find_element(allocator, child, offset);
+/**
+ * Track the brace depth across `text`, false when a brace closes below depth zero.
+ */
+static bool scan_braces(const char *text, size_t length, size_t *depth) {
+    for(size_t i = 0; i < length; i++) {
+        switch(text[i]) {
+            case '{': (*depth)++; break;
+            case '}':
+                if(*depth == 0) return false;
+                (*depth)--;
+                break;
         }
     }
+    return true;
+}
 
-    assert(charon_element_type(current->inner) == CHARON_ELEMENT_TYPE_TOKEN);
-    return current;
+/**
+ * Whether every brace in `text` closes a brace opened before it in `text`, and every opened brace is closed.
+ */
+static bool is_brace_balanced(const char *text, size_t length) {
+    size_t depth = 0;
+    return scan_braces(text, length, &depth) && depth == 0;
 }
 
-// Find the child that contains a given range.
-// - range_start is inclusive
-// - range_end is exclusive
-static charon_element_t *find_range(charon_memory_allocator_t *allocator, charon_element_t *element, size_t range_start, size_t range_end) {
-    assert(charon_element_type(element->inner) == CHARON_ELEMENT_TYPE_NODE);
+/**
+ * Whether the braces of the document text from `start` up to `end` are balanced, see `is_brace_balanced`.
+ */
+static bool is_text_brace_balanced(document_t *document, size_t start, size_t end) {
+    size_t depth = 0;
+    while(start < end) {
+        size_t chunk_size;
+        const char *chunk = rope_chunk(&document->text, start, &chunk_size);
+        if(chunk_size > end - start) chunk_size = end - start;
+        if(!scan_braces(chunk, chunk_size, &depth)) return false;
+        start += chunk_size;
+    }
+    return depth == 0;
+}
 
-    size_t low = 0;
-    size_t high = charon_element_node_child_count(element->inner) - 1;
-    while(low <= high) {
-        int mid = low + (high - low) / 2;
+/**
+ * Whether an edit starting at `range_start` leaves the lexing in front of `element` and the token its parent picked it by as they are,
+ * so that the element can be reparsed by itself with its entry point. The edit has to start after the text of the first token. Tokens only
+ * examine text past the end of their line when flagged with `charon_element_lookahead_past_line`, without those in front of the element an edit
+ * is safe anywhere in an element starting a line, otherwise only after the line the element starts on.
+ */
+static bool is_reparse_candidate(document_t *document, const charon_cursor_t *cursor, size_t range_start) {
+    const charon_element_inner_t *element = charon_cursor_element(cursor);
+    size_t offset = charon_cursor_offset(cursor);
+    size_t depth = charon_cursor_depth(cursor);
+    assert(depth > 0);
+
+    charon_parser_reparse_fn_t reparse_fn = charon_parser_reparse_fn(charon_element_node_kind(element));
+    if(reparse_fn == nullptr || charon_element_length(element) == 0) return false;
+    if(reparse_fn == charon_parser_parse_expr && charon_parser_reparse_fn(charon_element_node_kind(charon_cursor_frame(cursor, depth - 1)->inner)) == charon_parser_parse_expr) return false;
+
+    charon_cursor_t first_token;
+    charon_cursor_init(&first_token, element, offset);
+    find_element(&first_token, offset);
+    size_t first_text_end = charon_cursor_offset(&first_token) + charon_element_length(charon_cursor_element(&first_token)) - charon_element_token_trailing_trivia_length(charon_cursor_element(&first_token));
+    charon_cursor_free(&first_token);
+    if(range_start < first_text_end) return false;
+
+    for(size_t i = depth; i > 0; i--) {
+        const charon_element_inner_t *parent = charon_cursor_frame(cursor, i - 1)->inner;
+        for(size_t j = 0; j < charon_cursor_frame(cursor, i)->index; j++) {
+            if(charon_element_lookahead_past_line(charon_element_node_child(parent, j))) return false;
+        }
+    }
+
+    if(offset == 0 || rope_at(&document->text, offset - 1) == '\n') return true;
+    return rope_find(&document->text, offset, range_start, '\n') != range_start;
+}
 
-        charon_element_t *child = charon_element_wrap_node_child(allocator, element, mid);
-        size_t child_start = child->offset;
-        size_t child_end = child_start + charon_element_length(child->inner);
+/**
+ * Reparse `element` by itself from the edited document text, lexing incrementally against its old subtree. The parsed text runs on to the end of
+ * the line of the token following the element, so that the tokens of the element and the following token lex as they do in place, unless they
+ * look past their line. The result is only taken when the parse ended on the following token, and when free of errors unless the element
+ * recovers from errors the same anywhere. Blocks and top level items do, other nodes recover on tokens that depend on their ancestors.
+ * The root is parsed from the whole text and always taken, which is why it is the last candidate.
+ */
+static bool reparse_element(document_t *document, charon_element_t *root, charon_element_t *element, size_t range_start, size_t range_length, size_t new_text_size, charon_parser_output_t *output) {
+    charon_node_kind_t kind = charon_element_node_kind(element->inner);
+    size_t length = charon_element_length(element->inner);
+    size_t reparse_length = length - range_length + new_text_size;
+
+    // The text after the element did not change, it is only shifted by the edit
+    size_t text_size = rope_size(&document->text);
+    size_t fragment_end = text_size;
+    if(element->offset + length < charon_element_length(root->inner)) {
+        charon_cursor_t follow_token;
+        charon_cursor_init(&follow_token, root->inner, 0);
+        find_element(&follow_token, element->offset + length);
+        size_t follow_text_end = charon_cursor_offset(&follow_token) + charon_element_length(charon_cursor_element(&follow_token)) - charon_element_token_trailing_trivia_length(charon_cursor_element(&follow_token)) - range_length + new_text_size;
+        charon_cursor_free(&follow_token);
+        size_t newline = rope_find(&document->text, follow_text_end, text_size, '\n');
+        if(newline != text_size) fragment_end = newline + 1;
+    }
 
-        if(range_start >= child_start && range_end <= child_end) return child;
+    // The lexer works on contiguous text, only the fragment is copied out of the rope
+    charon_utf8_text_t *text = charon_utf8_make(fragment_end - element->offset);
+    rope_copy(&document->text, element->offset, fragment_end - element->offset, charon_utf8_data(text));
 
-        if(range_start >= child_start) {
-            low = mid + 1;
-        } else {
-            high = mid - 1;
-        }
+    // Error recovery can repeat the end of file token along with its leading trivia, a root running past the text is lexed afresh
+    charon_lexer_t *lexer;
+    if(element->parent == nullptr && reparse_length != text_size) {
+        lexer = charon_lexer_make(document->cache, text);
+    } else {
+        lexer = charon_lexer_make_incremental(document->cache, text, element->inner, range_start - element->offset, range_length, new_text_size);
     }
-    return nullptr;
-}
 
-static void edit_text(char **text, size_t *text_length, size_t range_start, size_t range_end, const char *text_changed, size_t text_changed_length) {
-    assert(range_start <= range_end && range_end <= *text_length);
+    charon_parser_t *parser = charon_parser_make(document->cache, lexer);
+    *output = charon_parser_reparse_fn(kind)(parser);
+
+    charon_parser_destroy(parser);
+    charon_lexer_destroy(lexer);
 
-    size_t range_length = range_end - range_start;
+    free(text);
 
-    size_t new_length = *text_length - range_length + text_changed_length;
-    char *new = malloc(new_length);
+    if(element->parent == nullptr) return true;
+
+    bool is_reparsed = charon_element_node_kind(output->root) == kind && charon_element_length(output->root) == reparse_length;
+    if(output->is_end_examined && fragment_end != text_size) is_reparsed = false;
+    switch(kind) {
+        case CHARON_NODE_KIND_STMT_BLOCK:
+        case CHARON_NODE_KIND_TLC_MODULE:
+        case CHARON_NODE_KIND_TLC_FUNCTION:
+        case CHARON_NODE_KIND_TLC_EXTERN:
+        case CHARON_NODE_KIND_TLC_DECLARATION:
+        case CHARON_NODE_KIND_TLC_TYPE_DEFINITION:
+        case CHARON_NODE_KIND_TLC_ENUMERATION:    break;
+        default:                                  is_reparsed = is_reparsed && !charon_element_has_error(output->root); break;
+    }
+    if(is_reparsed) return true;
 
-    memcpy(new, *text, range_start);
-    memcpy(&new[range_start], text_changed, text_changed_length);
-    memcpy(&new[range_start + text_changed_length], &(*text)[range_end], *text_length - range_end);
+    lsp_log("Reparse of %s failed", charon_node_kind_tostring(kind));
 
-    free(*text);
+    charon_diag_item_t *next_diag = output->diagnostics;
+    while(next_diag != nullptr) {
+        charon_diag_item_t *diag = next_diag;
+        next_diag = diag->next;
 
-    *text = new;
-    *text_length = new_length;
+        charon_path_destroy(diag->path);
+        free(diag);
+    }
+    return false;
 }
 
 static void publish_diagnostics(document_t *document) {
     struct json_object *diagnostics = json_object_new_array();
 
-    charon_memory_allocator_t *allocator = charon_memory_allocator_make();
-    charon_element_t *root_element = charon_element_wrap_root(allocator, document->root_element);
     for(charon_diag_item_t *diag = document->diagnostics; diag != nullptr; diag = diag->next) {
-        charon_element_t *current_element = root_element;
+        charon_cursor_t cursor;
+        charon_cursor_init(&cursor, document->root_element, 0);
         for(size_t i = 0; i < diag->path->length; i++) {
-            size_t index = diag->path->steps[i];
-            assert(charon_element_type(current_element->inner) == CHARON_ELEMENT_TYPE_NODE);
-            assert(charon_element_node_child_count(current_element->inner) > index);
-            current_element = charon_element_wrap_node_child(allocator, current_element, diag->path->steps[i]);
+            if(charon_cursor_goto_child(&cursor, diag->path->steps[i])) continue;
+            lsp_log("Diagnostic path leads outside the tree");
+            break;
         }
 
-        size_t length = charon_element_length(current_element->inner);
-        size_t offset = current_element->offset;
+        size_t length = charon_element_length(charon_cursor_element(&cursor));
+        size_t offset = charon_cursor_offset(&cursor);
+        charon_cursor_free(&cursor);
 
         size_t start_line, start_column, end_line, end_column;
-        document_offset_to_position(document, offset, &start_line, &start_column);
-        document_offset_to_position(document, offset + length, &end_line, &end_column);
+        charon_element_offset_to_position(document->root_element, offset, &start_line, &start_column);
+        charon_element_offset_to_position(document->root_element, offset + length, &end_line, &end_column);
 
         struct json_object *start_pos = json_object_new_object();
         json_object_object_add(start_pos, "line", json_object_new_uint64(start_line));
@@ -169,7 +249,6 @@ static void publish_diagnostics(document_t *document) {
 
         json_object_array_add(diagnostics, diag_obj);
     }
-    charon_memory_allocator_free(allocator);
 
     struct json_object *p = json_object_new_object();
     json_object_object_add(p, "uri", json_object_new_string(document->uri));
@@ -187,11 +266,8 @@ static void handle_open(struct json_object *message) {
     size_t data_length = strlen(data);
 
     document_t *document = document_get(json_object_get_string(uri));
-    document->text = strdup(data);
-    document->text_size = data_length;
-
-    linedb_clear(&document->linedb);
-    linedb_build(&document->linedb, data, data_length);
+    rope_free(&document->text);
+    rope_init(&document->text, data, data_length);
 
     charon_utf8_text_t *text = charon_utf8_from(data, data_length);
     charon_lexer_t *lexer = charon_lexer_make(document->cache, text);
@@ -200,6 +276,7 @@ static void handle_open(struct json_object *message) {
     charon_parser_output_t parser_output = charon_parser_parse_root(parser);
     document->diagnostics = parser_output.diagnostics;
     document->root_element = parser_output.root;
+    document->cache_live_size = charon_element_cache_size(document->cache);
 
     charon_parser_destroy(parser);
     charon_lexer_destroy(lexer);
@@ -239,76 +316,54 @@ static void handle_change(struct json_object *message) {
         lsp_log("===> [%lu:%lu - %lu:%lu] changed to (%lu)%s", start_line, start_column, end_line, end_column, new_text_size, new_text);
 
         // Compute range
-        size_t range_start = document_position_to_offset(document, start_line, start_column);
-        size_t range_end = document_position_to_offset(document, end_line, end_column);
-
-        // Determine the narrowest reparse
-        enum {
-            REPARSE_LEVEL_FULL,
-            REPARSE_LEVEL_BLOCK
-        } reparse_level = REPARSE_LEVEL_BLOCK;
-
-        for(size_t i = 0; i < new_text_size; i++) {
-            switch(new_text[i]) {
-                case '{':
-                case '}': reparse_level = REPARSE_LEVEL_FULL; break;
-            }
-        }
+        size_t range_start = charon_element_position_to_offset(document->root_element, start_line, start_column);
+        size_t range_end = charon_element_position_to_offset(document->root_element, end_line, end_column);
 
-        for(size_t i = range_start; i < range_end; i++) {
-            switch(document->text[i]) {
-                case '{':
-                case '}': reparse_level = REPARSE_LEVEL_FULL; break;
-            }
-        }
-
-        // Find the LCA
-        charon_memory_allocator_t *allocator = charon_memory_allocator_make();
+        // Collect the reparse candidates, the root followed by the enclosing nodes with a reparse entry point from outermost to innermost
+        charon_memory_allocator_t *allocator = document->scratch_allocator;
+        charon_memory_checkpoint_t checkpoint = charon_memory_checkpoint(allocator);
         charon_element_t *root = charon_element_wrap_root(allocator, document->root_element);
-        assert(charon_element_length(root->inner) == document->text_size);
-
-        charon_element_t *lca = root;
-        if(reparse_level == REPARSE_LEVEL_BLOCK) {
-            charon_element_t *current = root;
-            while(current != nullptr && charon_element_type(current->inner) == CHARON_ELEMENT_TYPE_NODE) {
-                charon_node_kind_t kind = charon_element_node_kind(current->inner);
-                if(kind == CHARON_NODE_KIND_STMT_BLOCK) lca = current;
-                current = find_range(allocator, current, range_start, range_end);
-            }
-        }
-
-        // Expand reparse if edit falls into trailing trivia
-        {
-            charon_element_t *current = lca;
-            while(charon_element_type(current->inner) == CHARON_ELEMENT_TYPE_NODE) {
-                size_t child_count = charon_element_node_child_count(current->inner);
-                assert(child_count > 0);
-                current = charon_element_wrap_node_child(allocator, current, child_count - 1);
-            }
-            assert(charon_element_type(current->inner) == CHARON_ELEMENT_TYPE_TOKEN);
 
-            size_t trailing_length = charon_element_token_trailing_trivia_length(current->inner);
-            size_t token_length = charon_element_length(current->inner);
-            if(range_end >= current->offset + (token_length - trailing_length)) lca = root;
-        }
-
-        // Expand reparse if edit falls into leading trivia
-        {
-            charon_element_t *current = lca;
-            while(charon_element_type(current->inner) == CHARON_ELEMENT_TYPE_NODE) {
-                size_t child_count = charon_element_node_child_count(current->inner);
-                assert(child_count > 0);
-                current = charon_element_wrap_node_child(allocator, current, 0);
+        // Positions past the text resolve into a root that error recovery left longer than the text
+        size_t text_size = rope_size(&document->text);
+        if(range_start > text_size) range_start = text_size;
+        if(range_end > text_size) range_end = text_size;
+
+        size_t candidate_count = 1;
+        charon_element_t **candidates = malloc(sizeof(charon_element_t *));
+        candidates[0] = root;
+
+        // Edits that open or close blocks change which braces pair up, no enclosing element can hold them
+        if(is_brace_balanced(new_text, new_text_size) && is_text_brace_balanced(document, range_start, range_end)) {
+            charon_cursor_t cursor;
+            charon_cursor_init(&cursor, document->root_element, 0);
+            while(find_range(&cursor, range_start, range_end)) {
+                if(charon_element_type(charon_cursor_element(&cursor)) != CHARON_ELEMENT_TYPE_NODE) break;
+                if(charon_cursor_offset(&cursor) + charon_element_length(charon_cursor_element(&cursor)) > text_size) continue;
+                if(!is_reparse_candidate(document, &cursor, range_start)) continue;
+
+                candidates = reallocarray(candidates, ++candidate_count, sizeof(charon_element_t *));
+                candidates[candidate_count - 1] = charon_cursor_wrap(allocator, &cursor);
             }
-            assert(charon_element_type(current->inner) == CHARON_ELEMENT_TYPE_TOKEN);
-
-            size_t leading_length = charon_element_token_leading_trivia_length(current->inner);
-            if(range_start <= current->offset + leading_length) lca = root;
+            charon_cursor_free(&cursor);
         }
 
-        lsp_log("= BEFORE ============================================================");
-        lsp_log("%.*s", (int) charon_element_length(lca->inner), &document->text[lca->offset]);
-        lsp_log("=====================================================================");
+        /* Update the document text */
+        rope_edit(&document->text, range_start, range_end, new_text, new_text_size);
+
+        /* Reparse the innermost candidate that parses the same by itself, a candidate failing widens the reparse to the next one up to the root */
+        charon_element_t *lca;
+        charon_parser_output_t parser_output;
+        do {
+            assert(candidate_count > 0);
+            lca = candidates[--candidate_count];
+        } while(!reparse_element(document, root, lca, range_start, range_end - range_start, new_text_size, &parser_output));
+        free(candidates);
+
+        // Only the extent of the reparse is logged, the reparsed text can be the whole document
+        lsp_log("Range [%lu - %lu]", range_start, range_end);
+        lsp_log("New Text Size: %lu", new_text_size);
+        lsp_log("Reparsed %s at %lu: %lu -> %lu", charon_node_kind_tostring(charon_element_node_kind(lca->inner)), lca->offset, charon_element_length(lca->inner), charon_element_length(parser_output.root));
 
         /* Cull diagnostics within LCA */
         charon_path_t *lca_path = nullptr;
@@ -350,35 +405,6 @@ static void handle_change(struct json_object *message) {
         }
         assert(lca_path != nullptr);
 
-        /* Update the document text */
-        edit_text(&document->text, &document->text_size, range_start, range_end, new_text, new_text_size);
-        linedb_clear(&document->linedb);
-        linedb_build(&document->linedb, document->text, document->text_size);
-
-        /* Reparse */
-        size_t reparse_length = charon_element_length(lca->inner) - (range_end - range_start) + new_text_size;
-
-        lsp_log("Range [%lu - %lu]", range_start, range_end);
-        lsp_log("New Text Size: %lu", new_text_size);
-        lsp_log("%lu / %lu", charon_element_length(lca->inner), reparse_length);
-        lsp_log("= AFTER =============================================================");
-        lsp_log("%.*s", (int) reparse_length, &document->text[lca->offset]);
-        lsp_log("=====================================================================");
-
-        charon_utf8_text_t *text = charon_utf8_from(&document->text[lca->offset], reparse_length);
-        charon_lexer_t *lexer = charon_lexer_make(document->cache, text);
-
-        charon_parser_t *parser = charon_parser_make(document->cache, lexer);
-        charon_parser_output_t (*reparse_fn)(charon_parser_t *parser) = nullptr;
-        switch(charon_element_node_kind(lca->inner)) {
-            case CHARON_NODE_KIND_ROOT:       reparse_fn = charon_parser_parse_root; break;
-            case CHARON_NODE_KIND_STMT_BLOCK: reparse_fn = charon_parser_parse_stmt_block; break;
-            default:                          assert(false);
-        }
-        assert(reparse_fn != nullptr);
-
-        charon_parser_output_t parser_output = reparse_fn(parser);
-
         charon_diag_item_t *next_diag = parser_output.diagnostics;
         while(next_diag != nullptr) {
             charon_diag_item_t *diag = next_diag;
@@ -397,14 +423,15 @@ static void handle_change(struct json_object *message) {
 
         charon_path_destroy(lca_path);
 
-        charon_parser_destroy(parser);
-        charon_lexer_destroy(lexer);
-
-        free(text);
-
         document->root_element = charon_util_element_swap(document->cache, lca, parser_output.root);
 
-        charon_memory_allocator_free(allocator);
+        charon_memory_rollback(allocator, checkpoint);
+
+        // The cache keeps the elements of every earlier tree, they are collected once they outnumber the live ones
+        if(charon_element_cache_size(document->cache) > 2 * document->cache_live_size) {
+            charon_element_cache_collect(document->cache, &document->root_element, 1);
+            document->cache_live_size = charon_element_cache_size(document->cache);
+        }
 
         publish_diagnostics(document);
 
@@ -427,25 +454,17 @@ void handle_hover(struct json_object *message) {
     document_t *document = document_get(json_object_get_string(uri));
     if(document->root_element == nullptr) return;
 
-    charon_memory_allocator_t *allocator = charon_memory_allocator_make();
-    charon_element_t *root_element = charon_element_wrap_root(allocator, document->root_element);
+    size_t offset = charon_element_position_to_offset(document->root_element, line, column);
 
-    size_t offset = document_position_to_offset(document, line, column);
-    charon_element_t *elem = find_element(allocator, root_element, offset);
+    charon_cursor_t cursor;
+    charon_cursor_init(&cursor, document->root_element, 0);
+    find_element(&cursor, offset);
 
     struct json_object *contents = json_object_new_object();
     json_object_object_add(contents, "kind", json_object_new_string("plaintext"));
-    if(elem == nullptr) {
-        json_object_object_add(contents, "value", json_object_new_string("Line index search failed."));
-    } else {
-        if(charon_element_type(elem->inner) == CHARON_ELEMENT_TYPE_TOKEN) {
-            json_object_object_add(contents, "value", json_object_new_string(charon_token_kind_tostring(charon_element_token_kind(elem->inner))));
-        } else {
-            json_object_object_add(contents, "value", json_object_new_string(charon_node_kind_tostring(charon_element_node_kind(elem->inner))));
-        }
-    }
+    json_object_object_add(contents, "value", json_object_new_string(charon_token_kind_tostring(charon_element_token_kind(charon_cursor_element(&cursor)))));
 
-    charon_memory_allocator_free(allocator);
+    charon_cursor_free(&cursor);
 
     struct json_object *result = json_object_new_object();
     json_object_object_add(result, "contents", contents);
@@ -0,0 +1,391 @@
+#include "replay.h"
+
+#include "document.h"
+#include "lsp.h"
+#include "rope.h"
+
+#include <charon/diag.h>
+#include <charon/element.h>
+#include <charon/lexer.h>
+#include <charon/parser.h>
+#include <charon/path.h>
+#include <charon/utf8.h>
+#include <json.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLAY_URI "file:///replay.charon"
+#define REPLAY_RANDOM_EDIT_COUNT 200
+#define REPLAY_RANDOM_SEED 0x2545f4914f6cdd1dULL
+
+typedef struct {
+    size_t start, end;
+    size_t text_size;
+    char *text;
+} replay_edit_t;
+
+static const char *g_snippets[] = { "x", " ", "\n", ";", "{", "}", "(", ")", "\"", "'", "//", "/*", "*/", "let q = 2;\n", "if (a) { b; }", "while (x) {\n    y;\n}\n", "return x;", "fn f() {}\n", "1 + 2 * 3" };
+
+static char *read_file(const char *path, size_t *size) {
+    FILE *file = fopen(path, "r");
+    if(file == nullptr) return nullptr;
+
+    char *data = nullptr;
+    size_t data_size = 0;
+    char buffer[4096];
+    size_t read;
+    while((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data = realloc(data, data_size + read + 1);
+        memcpy(&data[data_size], buffer, read);
+        data_size += read;
+    }
+    fclose(file);
+
+    if(data == nullptr) data = malloc(1);
+    data[data_size] = '\0';
+    *size = data_size;
+    return data;
+}
+
+/**
+ * Parse the edits of an edit file, see `replay_run`.
+ */
+static replay_edit_t *read_edits(const char *path, size_t *edit_count) {
+    size_t data_size;
+    char *data = read_file(path, &data_size);
+    if(data == nullptr) return nullptr;
+
+    replay_edit_t *edits = nullptr;
+    size_t count = 0;
+    for(char *line = data; line < &data[data_size];) {
+        char *line_end = memchr(line, '\n', &data[data_size] - line);
+        if(line_end == nullptr) line_end = &data[data_size];
+        *line_end = '\0';
+
+        replay_edit_t edit;
+        int text_offset;
+        if(sscanf(line, "%zu %zu%n", &edit.start, &edit.end, &text_offset) == 2) {
+            const char *text = &line[text_offset];
+            if(*text == ' ') text++;
+
+            edit.text = malloc(strlen(text) + 1);
+            edit.text_size = 0;
+            for(; *text != '\0'; text++) {
+                char ch = *text;
+                if(ch == '\\' && text[1] != '\0') {
+                    text++;
+                    switch(*text) {
+                        case 'n': ch = '\n'; break;
+                        case 't': ch = '\t'; break;
+                        default:  ch = *text; break;
+                    }
+                }
+                edit.text[edit.text_size++] = ch;
+            }
+            edit.text[edit.text_size] = '\0';
+
+            edits = reallocarray(edits, count + 1, sizeof(replay_edit_t));
+            edits[count++] = edit;
+        }
+        line = line_end + 1;
+    }
+    free(data);
+
+    *edit_count = count;
+    return edits;
+}
+
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/**
+ * Generate an edit of the text, inserting a snippet, deleting a few bytes or replacing them. Edits start and end on character boundaries.
+ */
+static replay_edit_t random_edit(uint64_t *state, const char *text, size_t text_size) {
+    replay_edit_t edit;
+    edit.start = next_random(state) % (text_size + 1);
+    while(edit.start < text_size && (text[edit.start] & 0xC0) == 0x80) edit.start++;
+
+    edit.end = edit.start;
+    if(next_random(state) % 5 < 2) edit.end += next_random(state) % 9;
+    if(edit.end > text_size) edit.end = text_size;
+    while(edit.end < text_size && (text[edit.end] & 0xC0) == 0x80) edit.end++;
+
+    const char *snippet = "";
+    if(edit.end == edit.start || next_random(state) % 5 < 4) snippet = g_snippets[next_random(state) % (sizeof(g_snippets) / sizeof(g_snippets[0]))];
+    edit.text_size = strlen(snippet);
+    edit.text = strdup(snippet);
+    return edit;
+}
+
+/**
+ * Line and UTF-16 column of `offset` in `text`, counted from the text by decoding its characters rather than by the tree, so that the
+ * position lookups of the tree can be checked against it.
+ */
+static void text_position(const char *text, size_t offset, size_t *line, size_t *column) {
+    *line = 0;
+    *column = 0;
+    for(size_t i = 0; i < offset;) {
+        uint8_t lead = (uint8_t) text[i];
+        if(lead == '\n') {
+            (*line)++;
+            *column = 0;
+            i++;
+            continue;
+        }
+
+        size_t length = 1;
+        uint32_t codepoint = lead;
+        if((lead & 0xE0) == 0xC0) {
+            length = 2;
+            codepoint = lead & 0x1F;
+        } else if((lead & 0xF0) == 0xE0) {
+            length = 3;
+            codepoint = lead & 0x0F;
+        } else if((lead & 0xF8) == 0xF0) {
+            length = 4;
+            codepoint = lead & 0x07;
+        }
+        for(size_t j = 1; j < length && i + j < offset; j++) codepoint = (codepoint << 6) | ((uint8_t) text[i + j] & 0x3F);
+
+        // Code points past the basic multilingual plane take a surrogate pair
+        *column += codepoint >= 0x10000 ? 2 : 1;
+        i += length;
+    }
+}
+
+static struct json_object *make_position(const char *text, size_t offset) {
+    size_t line, column;
+    text_position(text, offset, &line, &column);
+
+    struct json_object *position = json_object_new_object();
+    json_object_object_add(position, "line", json_object_new_uint64(line));
+    json_object_object_add(position, "character", json_object_new_uint64(column));
+    return position;
+}
+
+/**
+ * Check the position lookups of the document tree against the position counted from the text, both ways.
+ */
+static bool check_position(document_t *document, const char *text, size_t offset, const char **mismatch) {
+    size_t line, column;
+    text_position(text, offset, &line, &column);
+
+    size_t tree_line, tree_column;
+    charon_element_offset_to_position(document->root_element, offset, &tree_line, &tree_column);
+    if(tree_line != line || tree_column != column) {
+        *mismatch = "position of an offset differs from the text";
+        return false;
+    }
+    if(charon_element_position_to_offset(document->root_element, line, column) != offset) {
+        *mismatch = "offset of a position differs from the text";
+        return false;
+    }
+    return true;
+}
+
+static void send_open(const char *text, size_t text_size) {
+    struct json_object *text_document = json_object_new_object();
+    json_object_object_add(text_document, "uri", json_object_new_string(REPLAY_URI));
+    json_object_object_add(text_document, "text", json_object_new_string_len(text, text_size));
+
+    struct json_object *params = json_object_new_object();
+    json_object_object_add(params, "textDocument", text_document);
+
+    struct json_object *message = json_object_new_object();
+    json_object_object_add(message, "method", json_object_new_string("textDocument/didOpen"));
+    json_object_object_add(message, "params", params);
+
+    lsp_dispatch(message);
+    json_object_put(message);
+}
+
+static void send_change(const char *text, const replay_edit_t *edit) {
+    struct json_object *range = json_object_new_object();
+    json_object_object_add(range, "start", make_position(text, edit->start));
+    json_object_object_add(range, "end", make_position(text, edit->end));
+
+    struct json_object *change = json_object_new_object();
+    json_object_object_add(change, "range", range);
+    json_object_object_add(change, "text", json_object_new_string_len(edit->text, edit->text_size));
+
+    struct json_object *changes = json_object_new_array();
+    json_object_array_add(changes, change);
+
+    struct json_object *text_document = json_object_new_object();
+    json_object_object_add(text_document, "uri", json_object_new_string(REPLAY_URI));
+
+    struct json_object *params = json_object_new_object();
+    json_object_object_add(params, "textDocument", text_document);
+    json_object_object_add(params, "contentChanges", changes);
+
+    struct json_object *message = json_object_new_object();
+    json_object_object_add(message, "method", json_object_new_string("textDocument/didChange"));
+    json_object_object_add(message, "params", params);
+
+    lsp_dispatch(message);
+    json_object_put(message);
+}
+
+static int compare_strings(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/**
+ * Describe every diagnostic by its message and path, sorted so that lists can be compared regardless of their order.
+ */
+static char **describe_diagnostics(charon_diag_item_t *diagnostics, size_t *count) {
+    char **descriptions = nullptr;
+    *count = 0;
+    for(charon_diag_item_t *diag = diagnostics; diag != nullptr; diag = diag->next) {
+        char *message = charon_diag_fmt(diag->kind, diag->data);
+
+        size_t length = strlen(message);
+        char *description = malloc(length + diag->path->length * 21 + 1);
+        memcpy(description, message, length);
+        for(size_t i = 0; i < diag->path->length; i++) length += sprintf(&description[length], ".%zu", diag->path->steps[i]);
+        description[length] = '\0';
+        free(message);
+
+        descriptions = reallocarray(descriptions, *count + 1, sizeof(char *));
+        descriptions[(*count)++] = description;
+    }
+    if(*count > 0) qsort(descriptions, *count, sizeof(char *), compare_strings);
+    return descriptions;
+}
+
+static void free_descriptions(char **descriptions, size_t count) {
+    for(size_t i = 0; i < count; i++) free(descriptions[i]);
+    free(descriptions);
+}
+
+/**
+ * Compare the document against the expected text and a fresh parse of it, the fresh tree is interned in the cache of the document
+ * so equal trees are the same element. The position lookups are checked at `start` and `end`.
+ */
+static bool check_document(document_t *document, const char *text, size_t text_size, size_t start, size_t end, const char **mismatch) {
+    size_t document_size = rope_size(&document->text);
+    char *document_text = malloc(document_size + 1);
+    rope_copy(&document->text, 0, document_size, document_text);
+    bool is_text_same = document_size == text_size && memcmp(document_text, text, text_size) == 0;
+    free(document_text);
+    if(!is_text_same) {
+        *mismatch = "document text differs from the edited text";
+        return false;
+    }
+    if(!check_position(document, text, start, mismatch) || !check_position(document, text, end, mismatch)) return false;
+
+    charon_utf8_text_t *fresh_text = charon_utf8_from(text, text_size);
+    charon_lexer_t *lexer = charon_lexer_make(document->cache, fresh_text);
+    charon_parser_t *parser = charon_parser_make(document->cache, lexer);
+    charon_parser_output_t output = charon_parser_parse_root(parser);
+    charon_parser_destroy(parser);
+    charon_lexer_destroy(lexer);
+    free(fresh_text);
+
+    bool is_same = true;
+    if(output.root != document->root_element) {
+        *mismatch = "tree differs from a fresh parse";
+        is_same = false;
+    } else {
+        size_t count, fresh_count;
+        char **descriptions = describe_diagnostics(document->diagnostics, &count);
+        char **fresh_descriptions = describe_diagnostics(output.diagnostics, &fresh_count);
+        if(count != fresh_count) is_same = false;
+        for(size_t i = 0; is_same && i < count; i++) is_same = strcmp(descriptions[i], fresh_descriptions[i]) == 0;
+        if(!is_same) *mismatch = "diagnostics differ from a fresh parse";
+        free_descriptions(descriptions, count);
+        free_descriptions(fresh_descriptions, fresh_count);
+    }
+
+    charon_diag_item_t *next_diag = output.diagnostics;
+    while(next_diag != nullptr) {
+        charon_diag_item_t *diag = next_diag;
+        next_diag = diag->next;
+
+        charon_path_destroy(diag->path);
+        free(diag->data);
+        free(diag);
+    }
+    return is_same;
+}
+
+bool replay_run(const char *path, const char *edits_path) {
+    size_t text_size;
+    char *text = read_file(path, &text_size);
+    if(text == nullptr) {
+        fprintf(stderr, "%s: cannot read file\n", path);
+        return false;
+    }
+
+    size_t edit_count = REPLAY_RANDOM_EDIT_COUNT;
+    replay_edit_t *edits = nullptr;
+    if(edits_path != nullptr) {
+        edits = read_edits(edits_path, &edit_count);
+        if(edits == nullptr) {
+            fprintf(stderr, "%s: cannot read file\n", edits_path);
+            free(text);
+            return false;
+        }
+    }
+
+    send_open(text, text_size);
+    document_t *document = document_get(REPLAY_URI);
+
+    bool ok = true;
+    const char *mismatch;
+    if(!check_document(document, text, text_size, 0, text_size, &mismatch)) {
+        fprintf(stderr, "%s: open: %s\n", path, mismatch);
+        ok = false;
+    }
+
+    uint64_t random_state = REPLAY_RANDOM_SEED;
+    for(size_t i = 0; ok && i < edit_count; i++) {
+        replay_edit_t edit = edits != nullptr ? edits[i] : random_edit(&random_state, text, text_size);
+        if(edit.start > edit.end || edit.end > text_size) {
+            fprintf(stderr, "%s: edit %zu: range %zu-%zu is outside the text\n", path, i + 1, edit.start, edit.end);
+            ok = false;
+            break;
+        }
+
+        // Edits are sent with the positions counted from the text, which the lookups of the tree have to agree with
+        if(!check_position(document, text, edit.start, &mismatch) || !check_position(document, text, edit.end, &mismatch)) {
+            fprintf(stderr, "%s: edit %zu (%zu-%zu): %s\n", path, i + 1, edit.start, edit.end, mismatch);
+            ok = false;
+            if(edits == nullptr) free(edit.text);
+            break;
+        }
+        send_change(text, &edit);
+
+        size_t new_text_size = text_size - (edit.end - edit.start) + edit.text_size;
+        char *new_text = malloc(new_text_size + 1);
+        memcpy(new_text, text, edit.start);
+        memcpy(&new_text[edit.start], edit.text, edit.text_size);
+        memcpy(&new_text[edit.start + edit.text_size], &text[edit.end], text_size - edit.end);
+        new_text[new_text_size] = '\0';
+        free(text);
+        text = new_text;
+        text_size = new_text_size;
+        if(edits == nullptr) free(edit.text);
+
+        if(!check_document(document, text, text_size, edit.start, edit.start + edit.text_size, &mismatch)) {
+            fprintf(stderr, "%s: edit %zu (%zu-%zu): %s\n", path, i + 1, edit.start, edit.end, mismatch);
+            ok = false;
+        }
+    }
+
+    if(edits != nullptr) {
+        for(size_t i = 0; i < edit_count; i++) free(edits[i].text);
+        free(edits);
+    }
+    document_free(document);
+    free(text);
+    return ok;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+/**
+ * Open the file at `path` and replay edits of it through the change handler, checking after every edit that the document text is
+ * the edited text and that the incrementally updated tree and diagnostics are the ones a fresh parse of the text produces.
+ * The edits are read from `edits_path` when given, otherwise a fixed pseudo random sequence of edits is generated.
+ * Edit files hold an edit per line, `START END TEXT` replaces the bytes from `START` up to `END` by the rest of the line after
+ * the space following `END`, in which `\n`, `\t` and `\\` are escapes. Mismatches are reported on stderr.
+ * Returns whether every edit matched.
+ */
+bool replay_run(const char *path, const char *edits_path);
@@ -0,0 +1,245 @@
+#include "rope.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROPE_CHUNK_SIZE 1024
+#define ROPE_SEED 0x9e3779b97f4a7c15ULL
+
+/**
+ * Chunk of the text, the tree is a treap ordered by text position with nodes above their children in priority.
+ * Chunks have room for `ROPE_CHUNK_SIZE` bytes so typing appends in place instead of making a node per edit.
+ */
+struct rope_node {
+    rope_node_t *left, *right;
+    uint64_t priority;
+    size_t total_size;
+    size_t size, capacity;
+    char data[];
+};
+
+static uint64_t rope_random(rope_t *rope) {
+    rope->seed ^= rope->seed << 13;
+    rope->seed ^= rope->seed >> 7;
+    rope->seed ^= rope->seed << 17;
+    return rope->seed;
+}
+
+static size_t node_total_size(const rope_node_t *node) {
+    return node == nullptr ? 0 : node->total_size;
+}
+
+static void node_update(rope_node_t *node) {
+    node->total_size = node_total_size(node->left) + node->size + node_total_size(node->right);
+}
+
+static rope_node_t *node_make(uint64_t priority, const char *data, size_t size) {
+    size_t capacity = size > ROPE_CHUNK_SIZE ? size : ROPE_CHUNK_SIZE;
+    rope_node_t *node = malloc(sizeof(rope_node_t) + capacity);
+    node->left = nullptr;
+    node->right = nullptr;
+    node->priority = priority;
+    node->size = size;
+    node->capacity = capacity;
+    node->total_size = size;
+    memcpy(node->data, data, size);
+    return node;
+}
+
+static void node_free(rope_node_t *node) {
+    if(node == nullptr) return;
+    node_free(node->left);
+    node_free(node->right);
+    free(node);
+}
+
+static rope_node_t *node_merge(rope_node_t *left, rope_node_t *right) {
+    if(left == nullptr) return right;
+    if(right == nullptr) return left;
+
+    if(left->priority > right->priority) {
+        left->right = node_merge(left->right, right);
+        node_update(left);
+        return left;
+    }
+    right->left = node_merge(left, right->left);
+    node_update(right);
+    return right;
+}
+
+/**
+ * Splits the tree into the text in front of `offset` and the text from it on, a chunk holding the offset is cut in two.
+ */
+static void node_split(rope_node_t *node, size_t offset, rope_node_t **left, rope_node_t **right) {
+    if(node == nullptr) {
+        *left = nullptr;
+        *right = nullptr;
+        return;
+    }
+
+    size_t left_size = node_total_size(node->left);
+    if(offset <= left_size) {
+        node_split(node->left, offset, left, &node->left);
+        node_update(node);
+        *right = node;
+        return;
+    }
+    if(offset >= left_size + node->size) {
+        node_split(node->right, offset - left_size - node->size, &node->right, right);
+        node_update(node);
+        *left = node;
+        return;
+    }
+
+    // the tail of the chunk takes the place of the node in the right tree, with its priority the right subtree stays below it
+    size_t cut = offset - left_size;
+    rope_node_t *tail = node_make(node->priority, &node->data[cut], node->size - cut);
+    tail->right = node->right;
+    node_update(tail);
+
+    node->size = cut;
+    node->right = nullptr;
+    node_update(node);
+
+    *left = node;
+    *right = tail;
+}
+
+/**
+ * Appends to the last chunk of the tree when the text fits in its room.
+ */
+static bool node_append(rope_node_t *node, const char *data, size_t size) {
+    if(node == nullptr) return false;
+
+    if(node->right != nullptr) {
+        if(!node_append(node->right, data, size)) return false;
+    } else {
+        if(node->capacity - node->size < size) return false;
+        memcpy(&node->data[node->size], data, size);
+        node->size += size;
+    }
+    node->total_size += size;
+    return true;
+}
+
+static rope_node_t *rope_append(rope_t *rope, rope_node_t *root, const char *data, size_t size) {
+    if(node_append(root, data, size)) return root;
+
+    for(size_t offset = 0; offset < size; offset += ROPE_CHUNK_SIZE) {
+        size_t chunk_size = size - offset < ROPE_CHUNK_SIZE ? size - offset : ROPE_CHUNK_SIZE;
+        root = node_merge(root, node_make(rope_random(rope), &data[offset], chunk_size));
+    }
+    return root;
+}
+
+/**
+ * Edits the text of a single chunk in place when the range lies within it and the result fits its room, which is the case for typing.
+ */
+static bool node_edit(rope_node_t *node, size_t start, size_t end, const char *text, size_t text_size) {
+    if(node == nullptr) return false;
+
+    size_t left_size = node_total_size(node->left);
+    if(start >= left_size && end <= left_size + node->size) {
+        if(node->size - (end - start) + text_size > node->capacity) return false;
+
+        start -= left_size;
+        end -= left_size;
+        memmove(&node->data[start + text_size], &node->data[end], node->size - end);
+        memcpy(&node->data[start], text, text_size);
+        node->size = node->size - (end - start) + text_size;
+    } else if(end <= left_size) {
+        if(!node_edit(node->left, start, end, text, text_size)) return false;
+    } else if(start >= left_size + node->size) {
+        if(!node_edit(node->right, start - left_size - node->size, end - left_size - node->size, text, text_size)) return false;
+    } else {
+        return false;
+    }
+    node_update(node);
+    return true;
+}
+
+void rope_init(rope_t *rope, const char *text, size_t text_size) {
+    rope->root = nullptr;
+    rope->seed = ROPE_SEED;
+    rope->root = rope_append(rope, nullptr, text, text_size);
+}
+
+void rope_free(rope_t *rope) {
+    node_free(rope->root);
+    rope->root = nullptr;
+}
+
+size_t rope_size(const rope_t *rope) {
+    return node_total_size(rope->root);
+}
+
+void rope_edit(rope_t *rope, size_t start, size_t end, const char *text, size_t text_size) {
+    assert(start <= end && end <= rope_size(rope));
+    if(node_edit(rope->root, start, end, text, text_size)) return;
+
+    rope_node_t *left, *middle, *right;
+    node_split(rope->root, start, &left, &right);
+    node_split(right, end - start, &middle, &right);
+    node_free(middle);
+
+    if(text_size > 0) left = rope_append(rope, left, text, text_size);
+    rope->root = node_merge(left, right);
+}
+
+const char *rope_chunk(const rope_t *rope, size_t offset, size_t *chunk_size) {
+    const rope_node_t *node = rope->root;
+    while(node != nullptr) {
+        size_t left_size = node_total_size(node->left);
+        if(offset < left_size) {
+            node = node->left;
+            continue;
+        }
+        if(offset < left_size + node->size) {
+            *chunk_size = left_size + node->size - offset;
+            return &node->data[offset - left_size];
+        }
+        offset -= left_size + node->size;
+        node = node->right;
+    }
+
+    *chunk_size = 0;
+    return nullptr;
+}
+
+char rope_at(const rope_t *rope, size_t offset) {
+    size_t chunk_size;
+    const char *chunk = rope_chunk(rope, offset, &chunk_size);
+    assert(chunk != nullptr);
+    return *chunk;
+}
+
+void rope_copy(const rope_t *rope, size_t offset, size_t size, char *buffer) {
+    while(size > 0) {
+        size_t chunk_size;
+        const char *chunk = rope_chunk(rope, offset, &chunk_size);
+        assert(chunk != nullptr);
+        if(chunk_size > size) chunk_size = size;
+
+        memcpy(buffer, chunk, chunk_size);
+        buffer += chunk_size;
+        offset += chunk_size;
+        size -= chunk_size;
+    }
+}
+
+size_t rope_find(const rope_t *rope, size_t start, size_t end, char ch) {
+    for(size_t offset = start; offset < end;) {
+        size_t chunk_size;
+        const char *chunk = rope_chunk(rope, offset, &chunk_size);
+        assert(chunk != nullptr);
+        if(chunk_size > end - offset) chunk_size = end - offset;
+
+        const char *found = memchr(chunk, ch, chunk_size);
+        if(found != nullptr) return offset + (found - chunk);
+        offset += chunk_size;
+    }
+    return end;
+}
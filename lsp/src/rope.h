@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct rope_node rope_node_t;
+
+/**
+ * Text stored as chunks in a balanced tree, so an edit splits and joins the tree in logarithmic time instead of copying the text.
+ */
+typedef struct {
+    rope_node_t *root;
+    uint64_t seed;
+} rope_t;
+
+void rope_init(rope_t *rope, const char *text, size_t text_size);
+void rope_free(rope_t *rope);
+
+size_t rope_size(const rope_t *rope);
+
+/**
+ * Replace the text from `start` up to `end` with `text`.
+ */
+void rope_edit(rope_t *rope, size_t start, size_t end, const char *text, size_t text_size);
+
+/**
+ * The contiguous text starting at `offset` up to the end of its chunk, `chunk_size` is set to the number of bytes available.
+ */
+const char *rope_chunk(const rope_t *rope, size_t offset, size_t *chunk_size);
+
+char rope_at(const rope_t *rope, size_t offset);
+void rope_copy(const rope_t *rope, size_t offset, size_t size, char *buffer);
+
+/**
+ * Offset of the first `ch` from `start` up to `end`, or `end` when there is none.
+ */
+size_t rope_find(const rope_t *rope, size_t start, size_t end, char ch);
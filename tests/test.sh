@@ -9,6 +9,14 @@ while [[ $# -gt 0 ]]; do
             MODE="all"
             shift
             ;;
+        -e|--exec)
+            MODE="exec"
+            shift
+            ;;
+        -r|--replay)
+            MODE="replay"
+            shift
+            ;;
         -*|--*)
             echo "Unknown option $1"
             exit 1
@@ -70,10 +78,50 @@ run_exec() {
     fi
 }
 
+# Replays edits through the language server, comparing the incrementally updated tree against a fresh parse after every edit.
+# Scripted edits are given by a .edits file next to the source, without one a fixed sequence of random edits is replayed.
+run_replay() {
+    TEST_PATH="${1%.charon}"
+    TEST_NAME="${TEST_PATH#tests/}"
+    TOTAL=$(($TOTAL+1))
+
+    EDITS_FILE=""
+    if [ -f "$TEST_PATH.edits" ]; then
+        EDITS_FILE="$TEST_PATH.edits"
+    fi
+
+    OUTPUT="$(./build/lsp/charonlsp --replay $1 $EDITS_FILE 2>&1)"
+    EXIT_CODE=$?
+    if [ $EXIT_CODE -eq 0 ]; then
+        print_result 1 $TEST_NAME
+        PASSED=$(($PASSED+1))
+    else
+        print_result 0 $TEST_NAME "replay exited with $EXIT_CODE"
+        FAILED=$(($FAILED+1))
+        echo "$OUTPUT"
+    fi
+}
+
+run_exec_tests() {
+    echo "| Running Execution Tests"
+    for TEST_FILE in tests/exec/*.test; do run_exec $TEST_FILE; done
+}
+
+run_replay_tests() {
+    echo "| Running Replay Tests"
+    for TEST_FILE in tests/exec/*.charon tests/replay/*.charon; do run_replay $TEST_FILE; done
+}
+
 case $MODE in
     all)
-        echo "| Running Execution Tests"
-        for TEST_FILE in tests/exec/*.test; do run_exec $TEST_FILE; done
-        echo "| Done $PASSED/$TOTAL Passed ($FAILED Failed)"
+        run_exec_tests
+        run_replay_tests
+        ;;
+    exec)
+        run_exec_tests
+        ;;
+    replay)
+        run_replay_tests
         ;;
 esac
+echo "| Done $PASSED/$TOTAL Passed ($FAILED Failed)"